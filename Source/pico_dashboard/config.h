@@ -9,13 +9,60 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-/* ---- ECU protocol -------------------------------------------------- */
+/* ---- ECU input sources --------------------------------------------- */
 
-#define ECU_INVENT_EMS      1       /* Invent Labs EMS, RS232 19200 bps */
-#define ECU_ME442           2       /* ME442, CAN bus 500 kbps          */
+/* Sources enabled at boot — both may run at once (protocol/ecu_input.h):
+ *   UART: Invent Labs EMS, RS232 19200 bps
+ *   CAN:  ME442, CAN bus, bit rate auto-detected (ECU_CAN_BITRATE)     */
+#ifndef ECU_SOURCE_UART
+#define ECU_SOURCE_UART     0
+#endif
+
+#ifndef ECU_SOURCE_CAN
+#define ECU_SOURCE_CAN      1
+#endif
+
+/* CAN bit rate in bit/s, or 0 to auto-detect (125k/250k/500k/1M).  A
+ * detected rate is saved to CAN_BITRATE_SD_PATH and tried first on the
+ * next boot. */
+#ifndef ECU_CAN_BITRATE
+#define ECU_CAN_BITRATE     0
+#endif
+
+/* CAN RX mode: 1 = one mailbox per DBC message ID (newest frame wins,
+ * other IDs filtered in the interrupt), 0 = FIFO of every frame */
+#ifndef ECU_CAN_RX_MAILBOX
+#define ECU_CAN_RX_MAILBOX  1
+#endif
+
+#ifndef CAN_BITRATE_SD_PATH
+#define CAN_BITRATE_SD_PATH "0:/can_bitrate.txt"
+#endif
 
-#ifndef ECU_PROTOCOL
-#define ECU_PROTOCOL        ECU_ME442
+/* Source whose value wins when both deliver a channel */
+#ifndef ECU_SOURCE_PREFERRED
+#define ECU_SOURCE_PREFERRED INVENT_EMS_SRC_CAN
+#endif
+
+/* Optional boot-time override of the above, read from the SD card.
+ * Empty string disables the lookup. */
+#ifndef ECU_CONFIG_SD_PATH
+#define ECU_CONFIG_SD_PATH  "0:/ecu.cfg"
+#endif
+
+#ifndef ECU_CONFIG_MAX_FILE_SIZE
+#define ECU_CONFIG_MAX_FILE_SIZE 4096
+#endif
+
+/* Optional CAN decode table on the SD card (built with
+ * tools/dbc2c.py --bin).  Falls back to the compiled-in ME442 DBC when
+ * the file is missing or invalid.  Empty string disables the lookup. */
+#ifndef CAN_DBC_SD_PATH
+#define CAN_DBC_SD_PATH     "0:/can_decode.cdb"
+#endif
+
+#ifndef CAN_DBC_MAX_FILE_SIZE
+#define CAN_DBC_MAX_FILE_SIZE (16 * 1024)
 #endif
 
 /* ---- Display ------------------------------------------------------- */
@@ -35,6 +82,47 @@
 #define DISP_ROTATION       LV_DISP_ROT_270
 #endif
 
+/* Queued panel commands (brightness, sleep) ride along with the next
+ * flush; when the screen is static they are sent at this interval */
+#ifndef DISP_CMD_POLL_MS
+#define DISP_CMD_POLL_MS    20
+#endif
+
+/* The panel is round: flush only the part of each area inside the
+ * visible circle, as bands of rows with a window each.  A band grows
+ * while the corner pixels it sends cost less bus time than another
+ * window setup (3 commands, ~DISP_ROUND_BAND_COST_PX pixels' worth). */
+#ifndef DISP_ROUND_CLIP
+#define DISP_ROUND_CLIP     1
+#endif
+
+#ifndef DISP_ROUND_MARGIN
+#define DISP_ROUND_MARGIN   1       /* px sent beyond the circle's edge */
+#endif
+
+#ifndef DISP_ROUND_BAND_COST_PX
+#define DISP_ROUND_BAND_COST_PX 48
+#endif
+
+/* Frame pacing from the panel's tearing-effect pulse: a refresh starts
+ * on every DISP_TE_DIVIDER-th TE edge, right after the scan has left the
+ * visible area, instead of whenever LVGL's refresh timer comes due.
+ * Off until the module's TE routing (BSP_OLED_TE_PIN) is confirmed. */
+#ifndef ENABLE_TE_SYNC
+#define ENABLE_TE_SYNC      0
+#endif
+
+#ifndef DISP_TE_DIVIDER
+#define DISP_TE_DIVIDER     2       /* ~60 Hz scan: keeps the 30 fps budget */
+#endif
+
+/* Refresh timer period while TE paces the frames: only fires if TE
+ * stays away longer than this.  With no TE at all the display port goes
+ * back to LV_DISP_DEF_REFR_PERIOD. */
+#ifndef DISP_TE_FALLBACK_MS
+#define DISP_TE_FALLBACK_MS 40
+#endif
+
 /* ---- CPU clock (MHz) ----------------------------------------------- */
 
 #ifndef CPU_CLOCK_MHZ
@@ -53,6 +141,28 @@
 #define DASHBOARD_UPDATE_MS 50      /* arc gauge refresh interval */
 #endif
 
+/* Core 1 task periods (sched/exec.h).  The UART's RX interrupt wakes
+ * its task on the first bytes of a burst; while the DMA drains the FIFO
+ * the poll period bounds the latency (~2 bytes at 19200).  A quiet line
+ * leaves only the idle watchdog, which catches a missed wake-up.
+ * CAN frames release their task from the RX interrupt; the period only
+ * keeps the auto-baud search stepping on a quiet bus. */
+#ifndef ECU_UART_POLL_US
+#define ECU_UART_POLL_US    1000
+#endif
+
+#ifndef ECU_UART_IDLE_US
+#define ECU_UART_IDLE_US    200000
+#endif
+
+#ifndef ECU_CAN_POLL_US
+#define ECU_CAN_POLL_US     10000
+#endif
+
+#ifndef ECU_CHANNEL_STALE_MS
+#define ECU_CHANNEL_STALE_MS 1000   /* gauge shows "--" after this long */
+#endif
+
 /* ---- Debug console ------------------------------------------------- */
 
 #ifndef ENABLE_DEBUG_CONSOLE
@@ -63,4 +173,84 @@
 #define DEBUG_STATS_UPDATE_MS 200
 #endif
 
+/* ---- Diagnostics --------------------------------------------------- */
+
+/* Bus-to-glass latency histograms (diag/latency_trace.h) */
+#ifndef ENABLE_LATENCY_TRACE
+#define ENABLE_LATENCY_TRACE 1
+#endif
+
+#ifndef LATENCY_EXPORT_SD_PATH
+#define LATENCY_EXPORT_SD_PATH "0:/latency.csv"
+#endif
+
+#ifndef LATENCY_EXPORT_MS
+#define LATENCY_EXPORT_MS 30000     /* CSV rewrite interval, 0 = never */
+#endif
+
+/* FPS, render/flush split and CPU load (diag/render_perf.h), shown on
+ * the debug console's second page */
+#ifndef ENABLE_RENDER_PERF
+#define ENABLE_RENDER_PERF ENABLE_DEBUG_CONSOLE
+#endif
+
+/* Stack high-water per core and LVGL/malloc heap peaks (diag/mem_watch.h),
+ * on the same page */
+#ifndef ENABLE_MEM_WATCH
+#define ENABLE_MEM_WATCH ENABLE_DEBUG_CONSOLE
+#endif
+
+#ifndef MEM_STACK_WARN_BYTES
+#define MEM_STACK_WARN_BYTES 256    /* dlog warning below this much headroom */
+#endif
+
+/* PC sampling profiler on both cores (diag/profiler.h); dumped to the
+ * card with the span trace on a long press */
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER ENABLE_DEBUG_CONSOLE
+#endif
+
+#ifndef PROFILER_PERIOD_US
+#define PROFILER_PERIOD_US 499      /* ~2 kHz; prime, so it does not lock
+                                       onto the 1 ms tick or task periods */
+#endif
+
+#ifndef PROFILER_SLOTS
+#define PROFILER_SLOTS 1024         /* distinct (pc, lr) per core, 2^n; 12 B each */
+#endif
+
+#ifndef PROFILER_SD_PATH
+#define PROFILER_SD_PATH "0:/prof%02u.bin"  /* up to TRACE_SD_MAX_FILES */
+#endif
+
+/* Deferred binary log (libraries/bsp/dlog.h; level and ring size are
+ * set there).  Drained to the SD card and, in a -DDLOG_USB=ON build, to
+ * USB CDC; decode either with tools/dlog_decode.py */
+#ifndef DLOG_SD_PATH
+#define DLOG_SD_PATH "0:/dlog.bin"  /* appended; "" = not on the card */
+#endif
+
+#ifndef DLOG_DRAIN_MS
+#define DLOG_DRAIN_MS 50
+#endif
+
+#ifndef DLOG_SD_SYNC_MS
+#define DLOG_SD_SYNC_MS 5000        /* reopen the file: bounds loss on power-off */
+#endif
+
+#ifndef DLOG_USB
+#define DLOG_USB 0
+#endif
+
+/* Span trace (libraries/bsp/trace_span.h): a long press on the dashboard
+ * writes the last events of both cores as Chrome trace JSON, numbered
+ * per dump (trace00.json, trace01.json, ...) */
+#ifndef TRACE_SD_PATH
+#define TRACE_SD_PATH "0:/trace%02u.json"
+#endif
+
+#ifndef TRACE_SD_MAX_FILES
+#define TRACE_SD_MAX_FILES 100
+#endif
+
 #endif /* CONFIG_H */
@@ -0,0 +1,223 @@
+/**
+ * latency_trace.c — sampled bus-to-glass latency histograms
+ *
+ * A single trace is in flight at a time.  Its stage stamps are owned by
+ * whichever side holds it; `state` hands it over, and every transition
+ * is a compare-exchange so a timed-out trace can never clobber a new
+ * one.  Histograms are only written on core 0 (UI stage and flush ISR).
+ */
+
+#include "latency_trace.h"
+
+#if ENABLE_LATENCY_TRACE
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+/* ---- Histogram: 0..7 µs exact, then 4 buckets per octave ---- */
+
+#define LATENCY_BUCKETS 80              /* up to ~2 s; larger clamps */
+
+static uint32_t hist[LATENCY_STAGE_COUNT][LATENCY_BUCKETS];
+static uint32_t hist_max[LATENCY_STAGE_COUNT];
+
+static unsigned bucket_of(uint32_t us)
+{
+    if (us < 8)
+        return us;
+    unsigned msb = 31u - (unsigned)__builtin_clz(us);
+    unsigned idx = 8 + (msb - 3) * 4 + ((us >> (msb - 2)) & 3);
+    return idx < LATENCY_BUCKETS ? idx : LATENCY_BUCKETS - 1;
+}
+
+static uint32_t bucket_upper(unsigned idx)
+{
+    if (idx < 8)
+        return idx;
+    unsigned msb = 3 + (idx - 8) / 4;
+    unsigned sub = (idx - 8) % 4;
+    return ((5u + sub) << (msb - 2)) - 1;
+}
+
+static void record(latency_stage_t stage, uint32_t us)
+{
+    hist[stage][bucket_of(us)]++;
+    if (us > hist_max[stage])
+        hist_max[stage] = us;
+}
+
+/* ---- Trace in flight ---- */
+
+enum { T_RX, T_DECODE, T_PUBLISH, T_UI, T_RENDER, T_GLASS, T_COUNT };
+
+enum {
+    TRACE_IDLE,             /* free: core 1 may start one */
+    TRACE_PUBLISHED,        /* core 1 → core 0 */
+    TRACE_UI,
+    TRACE_RENDERED,
+};
+
+static _Atomic uint8_t   state = TRACE_IDLE;
+static uint32_t          stamp[T_COUNT];
+static uint32_t          trace_gen;
+static volatile uint32_t completed;
+
+static bool transition(uint8_t from, uint8_t to)
+{
+    return atomic_compare_exchange_strong(&state, &from, to);
+}
+
+/* ---- Core 1 ---- */
+
+static uint32_t pass_rx;                /* earliest input of this pass */
+static bool     pass_have_rx;
+
+void latency_rx(uint32_t t_us)
+{
+    if (!pass_have_rx || (int32_t)(t_us - pass_rx) < 0) {
+        pass_rx = t_us;
+        pass_have_rx = true;
+    }
+}
+
+void latency_pass(uint32_t generation, uint32_t t_decoded)
+{
+    /* Inputs that did not complete a sample (e.g. half a UART packet)
+     * are not traced: rx is when the sample's last input arrived */
+    if (generation != 0 && pass_have_rx &&
+        atomic_load(&state) == TRACE_IDLE) {
+        stamp[T_RX]      = pass_rx;
+        stamp[T_DECODE]  = t_decoded;
+        stamp[T_PUBLISH] = time_us_32();
+        trace_gen        = generation;
+        transition(TRACE_IDLE, TRACE_PUBLISHED);    /* release stamps */
+    }
+    pass_have_rx = false;
+}
+
+/* ---- Core 0 ---- */
+
+void latency_ui(uint32_t generation, bool redrawn)
+{
+    uint8_t  s   = atomic_load(&state);
+    uint32_t now = time_us_32();
+
+    if (s != TRACE_IDLE && now - stamp[T_PUBLISH] > LATENCY_TIMEOUT_US) {
+        transition(s, TRACE_IDLE);              /* abandoned */
+        return;
+    }
+    if (s != TRACE_PUBLISHED || (int32_t)(generation - trace_gen) < 0)
+        return;
+
+    if (!redrawn) {
+        transition(TRACE_PUBLISHED, TRACE_IDLE);
+        return;
+    }
+    stamp[T_UI] = now;
+    transition(TRACE_PUBLISHED, TRACE_UI);
+}
+
+void latency_rendered(void)
+{
+    if (atomic_load(&state) != TRACE_UI)
+        return;
+    stamp[T_RENDER] = time_us_32();
+    transition(TRACE_UI, TRACE_RENDERED);
+}
+
+void latency_flushed(void)
+{
+    if (atomic_load(&state) != TRACE_RENDERED)
+        return;
+    stamp[T_GLASS] = time_us_32();
+
+    for (int i = 0; i < T_GLASS; i++)
+        record((latency_stage_t)i, stamp[i + 1] - stamp[i]);
+    record(LATENCY_TOTAL, stamp[T_GLASS] - stamp[T_RX]);
+    completed++;
+
+    transition(TRACE_RENDERED, TRACE_IDLE);
+}
+
+/* ---- Reporting ---- */
+
+static void summarise(latency_stage_t stage, latency_summary_t *out)
+{
+    const uint32_t *h = hist[stage];
+    uint32_t n = 0;
+    for (unsigned i = 0; i < LATENCY_BUCKETS; i++)
+        n += h[i];
+
+    out->count  = n;
+    out->p50_us = 0;
+    out->p99_us = 0;
+    out->max_us = hist_max[stage];
+    if (n == 0)
+        return;
+
+    uint32_t p50 = (n + 1) / 2, p99 = n - n / 100, acc = 0;
+    for (unsigned i = 0; i < LATENCY_BUCKETS; i++) {
+        acc += h[i];
+        if (out->p50_us == 0 && acc >= p50) out->p50_us = bucket_upper(i);
+        if (acc >= p99) { out->p99_us = bucket_upper(i); break; }
+    }
+    if (out->p50_us > out->max_us) out->p50_us = out->max_us;
+    if (out->p99_us > out->max_us) out->p99_us = out->max_us;
+}
+
+void latency_get_summary(latency_summary_t out[LATENCY_STAGE_COUNT])
+{
+    for (int s = 0; s < LATENCY_STAGE_COUNT; s++)
+        summarise((latency_stage_t)s, &out[s]);
+}
+
+uint32_t latency_completed(void)
+{
+    return completed;
+}
+
+size_t latency_export_csv(char *buf, size_t size)
+{
+    static const char *const names[LATENCY_STAGE_COUNT] = {
+        "decode", "publish", "ui", "render", "glass", "total"
+    };
+    size_t n = 0;
+
+#define OUT(...) do {                                                   \
+        int w_ = snprintf(buf + n, size - n, __VA_ARGS__);              \
+        if (w_ < 0 || (size_t)w_ >= size - n) return n;                 \
+        n += (size_t)w_;                                                \
+    } while (0)
+
+    latency_summary_t sum[LATENCY_STAGE_COUNT];
+    latency_get_summary(sum);
+
+    OUT("# stage,count,p50_us,p99_us,max_us\n");
+    for (int s = 0; s < LATENCY_STAGE_COUNT; s++)
+        OUT("# %s,%lu,%lu,%lu,%lu\n", names[s],
+            (unsigned long)sum[s].count, (unsigned long)sum[s].p50_us,
+            (unsigned long)sum[s].p99_us, (unsigned long)sum[s].max_us);
+
+    OUT("bucket_le_us");
+    for (int s = 0; s < LATENCY_STAGE_COUNT; s++)
+        OUT(",%s", names[s]);
+    OUT("\n");
+
+    for (unsigned i = 0; i < LATENCY_BUCKETS; i++) {
+        bool any = false;
+        for (int s = 0; s < LATENCY_STAGE_COUNT; s++)
+            any |= hist[s][i] != 0;
+        if (!any) continue;
+
+        OUT("%lu", (unsigned long)bucket_upper(i));
+        for (int s = 0; s < LATENCY_STAGE_COUNT; s++)
+            OUT(",%lu", (unsigned long)hist[s][i]);
+        OUT("\n");
+    }
+#undef OUT
+    return n;
+}
+
+#endif /* ENABLE_LATENCY_TRACE */
@@ -0,0 +1,90 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "config.h"
+
+/*
+ * End-to-end ECU latency: bus → pixels on glass
+ *
+ * One sample at a time is followed through the pipeline.  Core 1 picks
+ * the next publish while no trace is in flight and stamps it; core 0
+ * carries the same trace through the UI update, the LVGL render and the
+ * display DMA.  Each stage's delta lands in a log-linear histogram
+ * (4 steps per octave, ~19 % resolution, 1 µs .. ~2.1 s; anything
+ * longer lands in the last bucket).
+ *
+ *   rx       CAN RX interrupt (frame timestamp) / UART bytes seen in
+ *            the DMA ring — the earliest input of the publish
+ *   decode   input drained into the decoders (core 1)
+ *   publish  snapshot handed over (invent_ems_publish)
+ *   ui       dashboard_update_cb acquired it and redrew a gauge
+ *   render   LVGL rendered the last area of the next refresh
+ *   glass    last flush DMA completed
+ *
+ * A publish that changes no gauge is dropped at the UI stage; a trace
+ * that never completes is abandoned after LATENCY_TIMEOUT_US.  Stamps
+ * are time_us_32(): all deltas are far below its 71 minute wrap.
+ */
+
+typedef enum {
+    LATENCY_DECODE,         /* rx      → decode  */
+    LATENCY_PUBLISH,        /* decode  → publish */
+    LATENCY_UI,             /* publish → ui      */
+    LATENCY_RENDER,         /* ui      → render  */
+    LATENCY_GLASS,          /* render  → glass   */
+    LATENCY_TOTAL,          /* rx      → glass   */
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t p50_us;        /* bucket upper bound, capped at max */
+    uint32_t p99_us;
+    uint32_t max_us;        /* exact */
+} latency_summary_t;
+
+#define LATENCY_TIMEOUT_US  1000000u
+
+#if ENABLE_LATENCY_TRACE
+
+/* ---- Core 1 ---- */
+void latency_rx(uint32_t t_us);                 /* each input drained */
+void latency_pass(uint32_t generation, uint32_t t_decoded);  /* 0 = none */
+
+/* ---- Core 0 ---- */
+void latency_ui(uint32_t generation, bool redrawn);
+void latency_rendered(void);                    /* flush of last area */
+void latency_flushed(void);                     /* its DMA done (ISR) */
+
+void latency_get_summary(latency_summary_t out[LATENCY_STAGE_COUNT]);
+
+/* Summary and full histograms as CSV; returns the length written */
+size_t latency_export_csv(char *buf, size_t size);
+
+/* Traces completed so far (to skip exporting unchanged data) */
+uint32_t latency_completed(void);
+
+#else /* stubs — optimised away completely */
+
+static inline void latency_rx(uint32_t t_us) { (void)t_us; }
+static inline void latency_pass(uint32_t generation, uint32_t t_decoded)
+{ (void)generation; (void)t_decoded; }
+static inline void latency_ui(uint32_t generation, bool redrawn)
+{ (void)generation; (void)redrawn; }
+static inline void latency_rendered(void) {}
+static inline void latency_flushed(void) {}
+
+#endif /* ENABLE_LATENCY_TRACE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LATENCY_TRACE_H */
@@ -0,0 +1,86 @@
+/**
+ * mem_watch.c — stack painting and heap high-water marks
+ *
+ * Stack bounds come from the SDK linker script: core 0 runs on
+ * [__StackBottom, __StackTop) in SCRATCH_Y, core 1 on
+ * [__StackOneBottom, __StackOneTop) in SCRATCH_X.
+ */
+
+#include "mem_watch.h"
+
+#if ENABLE_MEM_WATCH
+
+#include <malloc.h>
+#include "lvgl.h"
+#include "dlog.h"
+
+#define PAINT           0x5AC3A55Cu
+#define PAINT_MARGIN    256         /* bytes left alone below the live SP */
+
+extern uint32_t __StackBottom[], __StackTop[];
+extern uint32_t __StackOneBottom[], __StackOneTop[];
+extern char     __end__[], __StackLimit[];
+
+static void paint(uint32_t *from, uint32_t *to)
+{
+    /* volatile: must not become a memset() call running on this stack */
+    for (volatile uint32_t *p = from; p < to; p++)
+        *p = PAINT;
+}
+
+void __attribute__((noinline)) mem_watch_paint_core0(void)
+{
+    uintptr_t sp;
+    __asm volatile ("mov %0, sp" : "=r" (sp));
+    paint(__StackBottom, (uint32_t *)(sp - PAINT_MARGIN));
+}
+
+void mem_watch_paint_core1(void)
+{
+    paint(__StackOneBottom, __StackOneTop);
+}
+
+static void measure(mem_stack_t *s, const uint32_t *bottom,
+                    const uint32_t *top)
+{
+    const uint32_t *p = bottom;
+    while (p < top && *p == PAINT)
+        p++;
+    s->size = (uint32_t)((top - bottom) * sizeof(uint32_t));
+    s->used = (uint32_t)((top - p) * sizeof(uint32_t));
+}
+
+void mem_watch_get_stats(mem_stats_t *out)
+{
+    static bool    warned[2];
+    static uint8_t frag_peak;
+
+    measure(&out->stack[0], __StackBottom, __StackTop);
+    measure(&out->stack[1], __StackOneBottom, __StackOneTop);
+    for (int c = 0; c < 2; c++) {
+        if (!warned[c] &&
+            out->stack[c].size - out->stack[c].used < MEM_STACK_WARN_BYTES) {
+            DLOG_WARN("mem: core %u stack high-water %u of %u bytes",
+                      c, out->stack[c].used, out->stack[c].size);
+            warned[c] = true;
+        }
+    }
+
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    if (mon.frag_pct > frag_peak)
+        frag_peak = mon.frag_pct;
+    out->lv_total         = mon.total_size;
+    out->lv_used          = mon.total_size - mon.free_size;
+    out->lv_max_used      = mon.max_used;
+    out->lv_biggest_free  = mon.free_biggest_size;
+    out->lv_frag_pct      = mon.frag_pct;
+    out->lv_frag_peak_pct = frag_peak;
+
+    struct mallinfo mi = mallinfo();
+    out->heap_size  = (uint32_t)(__StackLimit - __end__);
+    out->heap_arena = (uint32_t)mi.arena;
+    out->heap_used  = (uint32_t)mi.uordblks;
+}
+
+#endif /* ENABLE_MEM_WATCH */
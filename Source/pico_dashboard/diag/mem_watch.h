@@ -0,0 +1,72 @@
+#ifndef MEM_WATCH_H
+#define MEM_WATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+/*
+ * Stack and heap high-water marks
+ *
+ * Both stacks are painted with a pattern at boot; the deepest word no
+ * longer holding it is the high-water mark.  Interrupt handlers run on
+ * the stack of the core they interrupt (the SDK uses MSP throughout),
+ * so each core's figure includes its worst ISR nesting — there is no
+ * separate ISR stack to measure.
+ *
+ *   core 0   SCRATCH_Y, painted by mem_watch_paint_core0() first thing
+ *            in main()
+ *   core 1   SCRATCH_X, painted by mem_watch_paint_core1() before
+ *            multicore_launch_core1()
+ *
+ * Heaps: the LVGL pool (lv_mem_monitor; fragmentation is sampled at
+ * each call, so its peak is the worst seen at the stats interval) and
+ * the malloc arena, which never shrinks and so is its own high-water.
+ */
+
+typedef struct {
+    uint32_t size;
+    uint32_t used;          /* high-water */
+} mem_stack_t;
+
+typedef struct {
+    mem_stack_t stack[2];   /* core 0, core 1 */
+
+    uint32_t lv_total;
+    uint32_t lv_used;
+    uint32_t lv_max_used;
+    uint32_t lv_biggest_free;
+    uint8_t  lv_frag_pct;
+    uint8_t  lv_frag_peak_pct;
+
+    uint32_t heap_size;     /* malloc: end of .bss → end of RAM */
+    uint32_t heap_arena;    /* obtained from sbrk (high-water) */
+    uint32_t heap_used;     /* currently allocated */
+} mem_stats_t;
+
+#if ENABLE_MEM_WATCH
+
+void mem_watch_paint_core0(void);
+void mem_watch_paint_core1(void);
+
+/* Scan both stacks and the heaps (core 0; ~10 µs + the lv_mem walk).
+ * Logs a warning the first time a stack has less than
+ * MEM_STACK_WARN_BYTES left. */
+void mem_watch_get_stats(mem_stats_t *out);
+
+#else /* stubs — optimised away completely */
+
+static inline void mem_watch_paint_core0(void) {}
+static inline void mem_watch_paint_core1(void) {}
+
+#endif /* ENABLE_MEM_WATCH */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MEM_WATCH_H */
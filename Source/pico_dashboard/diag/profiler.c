@@ -0,0 +1,136 @@
+/**
+ * profiler.c — timer-interrupt PC sampler
+ *
+ * Each core owns one alarm of TIMER0 and one table; only that core's
+ * handler writes it.  The export pauses sampling first, so it reads
+ * tables nobody is writing.
+ */
+
+#include "profiler.h"
+
+#if ENABLE_PROFILER
+
+#if !defined(__arm__)
+#error "profiler.c reads the Cortex-M exception frame"
+#endif
+
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hardware/structs/xip_ctrl.h"
+
+_Static_assert((PROFILER_SLOTS & (PROFILER_SLOTS - 1)) == 0,
+               "PROFILER_SLOTS must be a power of two");
+
+#define PROFILER_IRQ_PRIORITY   0x40    /* below CAN (0), above default */
+#define MAX_PROBE               8
+
+typedef struct {
+    uint32_t pc;
+    uint32_t lr;
+    uint32_t count;                     /* 0 = free slot */
+} pc_slot_t;
+
+typedef struct {
+    pc_slot_t slot[PROFILER_SLOTS];
+    uint32_t  samples;
+    uint32_t  dropped;                  /* probe sequence full */
+    uint      alarm;
+} pc_table_t;
+
+static pc_table_t    table[2];
+static volatile bool paused;
+
+/* Called from profiler_isr with the interrupted context's stack frame:
+ * r0 r1 r2 r3 r12 lr pc xpsr */
+void __not_in_flash_func(profiler_sample)(const uint32_t *frame)
+{
+    pc_table_t *t = &table[get_core_num()];
+
+    timer_hw->intr = 1u << t->alarm;
+    timer_hw->alarm[t->alarm] = timer_hw->timerawl + PROFILER_PERIOD_US;
+
+    if (paused)
+        return;
+
+    uint32_t pc = frame[6], lr = frame[5];
+    uint32_t h = ((pc >> 1) ^ (lr * 0x9E3779B1u)) * 0x9E3779B1u;
+    for (uint32_t i = 0; i < MAX_PROBE; i++) {
+        pc_slot_t *s = &t->slot[(h + i) & (PROFILER_SLOTS - 1)];
+        if (s->count == 0) {
+            s->pc = pc;
+            s->lr = lr;
+        } else if (s->pc != pc || s->lr != lr) {
+            continue;
+        }
+        s->count++;
+        t->samples++;
+        return;
+    }
+    t->dropped++;
+}
+
+/* Straight from the vector table: pick the stack the exception frame
+ * went to (EXC_RETURN bit 2) and tail-call the C half */
+static void __attribute__((naked)) __not_in_flash_func(profiler_isr)(void)
+{
+    __asm volatile (
+        "tst   lr, #4           \n"
+        "ite   eq               \n"
+        "mrseq r0, msp          \n"
+        "mrsne r0, psp          \n"
+        "b     profiler_sample  \n"
+    );
+}
+
+void profiler_start(void)
+{
+    pc_table_t *t = &table[get_core_num()];
+    t->alarm = (uint)hardware_alarm_claim_unused(true);
+
+    uint irq = hardware_alarm_get_irq_num(t->alarm);
+    irq_set_exclusive_handler(irq, profiler_isr);
+    irq_set_priority(irq, PROFILER_IRQ_PRIORITY);
+    hw_set_bits(&timer_hw->inte, 1u << t->alarm);
+    irq_set_enabled(irq, true);     /* on this core's NVIC only */
+
+    timer_hw->alarm[t->alarm] = timer_hw->timerawl + PROFILER_PERIOD_US;
+}
+
+/* ---- Export ---- */
+
+uint32_t profiler_export(void (*sink)(const void *data, uint32_t len))
+{
+    uint32_t total = 0;
+
+    paused = true;
+    busy_wait_us_32(10);        /* let a sample in progress on core 1 finish */
+
+    uint32_t head[4] = {
+        PROFILER_MAGIC, PROFILER_PERIOD_US,
+        xip_ctrl_hw->ctr_hit, xip_ctrl_hw->ctr_acc
+    };
+    xip_ctrl_hw->ctr_hit = 0;   /* any write clears */
+    xip_ctrl_hw->ctr_acc = 0;
+    sink(head, sizeof(head));
+
+    for (int c = 0; c < 2; c++) {
+        const pc_table_t *t = &table[c];
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < PROFILER_SLOTS; i++)
+            n += t->slot[i].count != 0;
+
+        uint32_t core_head[3] = { t->samples, t->dropped, n };
+        sink(core_head, sizeof(core_head));
+        for (uint32_t i = 0; i < PROFILER_SLOTS; i++)
+            if (t->slot[i].count)
+                sink(&t->slot[i], sizeof(t->slot[i]));
+        total += t->samples;
+    }
+
+    paused = false;
+    return total;
+}
+
+#endif /* ENABLE_PROFILER */
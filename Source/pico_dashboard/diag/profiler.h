@@ -0,0 +1,65 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+/*
+ * Statistical PC sampling profiler (both cores)
+ *
+ * Each core claims a timer alarm and takes its interrupt every
+ * PROFILER_PERIOD_US.  The handler reads the interrupted PC and LR from
+ * the exception frame and counts the pair in a per-core hash table in
+ * RAM — one short probe sequence, no stack walk, a couple of hundred
+ * cycles.  At the default period that is a fraction of a percent of a
+ * core, so it can stay on for a whole drive; the tables are cumulative
+ * since boot.
+ *
+ * The alarm interrupt sits above the SDK's default priority but below
+ * the CAN interrupt (0, for can2040's bit timing), so every other
+ * handler is sampled while the CAN handler itself is not; its time
+ * shows up on the span trace instead.  Time asleep in WFE is sampled
+ * too and shows up as the idle loops.
+ *
+ * The LR turns each sample into a two-level stack: for a leaf function
+ * it is the call site in the caller.  Non-leaf functions have usually
+ * overwritten it; tools/prof_report.py recognises and drops those.
+ *
+ * profiler_export() streams the tables in binary:
+ *
+ *     u32 magic 'PRF1', period_us, xip_hit, xip_acc
+ *     per core: u32 samples, dropped, n; n × { u32 pc, lr, count }
+ *
+ * xip_hit/xip_acc are the flash cache counters since the previous
+ * export (saturating).  The application writes it to the SD card on a
+ * long press (see pico_dashboard.cpp); tools/prof_report.py turns it
+ * into a flat profile and collapsed stacks for flamegraph tools.
+ */
+
+#define PROFILER_MAGIC  0x31465250u         /* "PRF1" */
+
+#if ENABLE_PROFILER
+
+/* Start sampling the calling core */
+void profiler_start(void);
+
+/* Stream both tables; returns the number of samples in them.  Sampling
+ * is paused meanwhile.  Core 0 only. */
+uint32_t profiler_export(void (*sink)(const void *data, uint32_t len));
+
+#else /* stubs — optimised away completely */
+
+static inline void profiler_start(void) {}
+
+#endif /* ENABLE_PROFILER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROFILER_H */
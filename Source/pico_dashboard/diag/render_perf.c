@@ -0,0 +1,179 @@
+/**
+ * render_perf.c — render performance counters
+ *
+ * Everything here runs on core 0: the hooks inside lv_timer_handler(),
+ * the flush DMA interrupt and the super-loop.  The per-refresh samples
+ * go through an SPSC ring (producer: monitor_cb, consumer: the stats
+ * timer); the DMA and idle totals are single 32-bit words, written in
+ * one place and read with a plain load.  The vsync figures are updated
+ * by two interrupts of equal priority and read as a group with
+ * interrupts off.
+ */
+
+#include "render_perf.h"
+
+#if ENABLE_RENDER_PERF
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "spsc_ring.h"
+#include "bsp_co5300.h"
+
+typedef struct {
+    uint32_t end_us;
+    uint32_t frame_us;
+    uint32_t wait_us;
+    uint32_t px;
+} frame_sample_t;
+
+/* 32 refreshes: over 150 fps at the 200 ms stats interval */
+SPSC_RING_DEFINE(static, samples, frame_sample_t, 32);
+
+static uint32_t          frame_t0;
+static uint32_t          frame_wait;
+static uint32_t          flush_t0;
+static volatile uint32_t dma_us;            /* total flush DMA time */
+static volatile uint32_t idle_us;           /* total super-loop WFE */
+static uint32_t          area_px;           /* total flushed area pixels */
+static uint32_t          sent_px;           /* total pixels sent */
+
+static uint32_t vsync_t;                    /* last paced TE edge */
+static uint32_t frame_vsync_t;              /* the edge the refresh followed */
+static uint32_t vsync_period;               /* last measured */
+static uint32_t vsync_n, vsync_sum, vsync_missed;
+static uint32_t headroom_n;
+static int32_t  headroom_sum, headroom_min;
+
+/* ---- Hooks ---- */
+
+void render_perf_frame_start(void)
+{
+    frame_t0      = time_us_32();
+    frame_wait    = 0;
+    frame_vsync_t = vsync_t;
+}
+
+void render_perf_wait(uint32_t us)
+{
+    frame_wait += us;
+}
+
+void render_perf_frame_end(uint32_t px)
+{
+    uint32_t now = time_us_32();
+    frame_sample_t s = {
+        .end_us   = now,
+        .frame_us = now - frame_t0,
+        .wait_us  = frame_wait,
+        .px       = px,
+    };
+    spsc_ring_push(&samples, &s, 1);
+}
+
+void render_perf_flush_start(uint32_t area, uint32_t sent)
+{
+    flush_t0 = time_us_32();
+    area_px += area;
+    sent_px += sent;
+}
+
+void render_perf_flush_done(void)
+{
+    dma_us += time_us_32() - flush_t0;
+}
+
+void render_perf_vsync(bool late)
+{
+    uint32_t now = time_us_32();
+    if (vsync_t) {
+        vsync_period = now - vsync_t;
+        vsync_n++;
+        vsync_sum += vsync_period;
+    }
+    vsync_t = now;
+    if (late)
+        vsync_missed++;
+}
+
+void render_perf_frame_flushed(void)
+{
+    if (!vsync_period)
+        return;                     /* no TE: nothing to measure against */
+    int32_t h = (int32_t)vsync_period -
+                (int32_t)(time_us_32() - frame_vsync_t);
+    if (headroom_n == 0 || h < headroom_min)
+        headroom_min = h;
+    headroom_n++;
+    headroom_sum += h;
+}
+
+void render_perf_idle(uint32_t us)
+{
+    idle_us += us;
+}
+
+/* ---- Reporting ---- */
+
+static uint8_t pct(uint32_t part, uint32_t whole)
+{
+    if (whole == 0) return 0;
+    uint32_t p = (uint32_t)(((uint64_t)part * 100) / whole);
+    return (uint8_t)(p > 100 ? 100 : p);
+}
+
+void render_perf_get_stats(render_perf_stats_t *out)
+{
+    static uint32_t prev_t, prev_dma, prev_idle, prev_area, prev_sent;
+
+    uint32_t now  = time_us_32();
+    uint32_t dma  = dma_us;
+    uint32_t idle = idle_us;
+    uint32_t span = now - prev_t;
+
+    uint32_t n = 0, frame_sum = 0, render_sum = 0, render_max = 0;
+    uint64_t px_sum = 0;
+    frame_sample_t s;
+    while (spsc_ring_pop(&samples, &s, 1) == 1) {
+        uint32_t render = s.frame_us - s.wait_us;
+        n++;
+        frame_sum  += s.frame_us;
+        render_sum += render;
+        if (render > render_max) render_max = render;
+        px_sum += s.px;
+    }
+
+    out->frames        = n;
+    out->fps_x10       = span ? (uint32_t)(((uint64_t)n * 10000000u) / span) : 0;
+    out->frame_avg_us  = n ? frame_sum / n : 0;
+    out->render_avg_us = n ? render_sum / n : 0;
+    out->render_max_us = render_max;
+    out->flush_avg_us  = n ? (dma - prev_dma) / n : 0;
+    out->flush_mbps_x10 = dma != prev_dma ?
+        (uint32_t)((uint64_t)(sent_px - prev_sent) * 2 * 10 /
+                   (dma - prev_dma)) : 0;
+    out->area_px_avg   = n ? (area_px - prev_area) / n : 0;
+    out->sent_px_avg   = n ? (sent_px - prev_sent) / n : 0;
+    out->px_per_s      = span ? (uint32_t)((px_sum * 1000000u) / span) : 0;
+    out->dma_pct       = pct(dma - prev_dma, span);
+    out->core0_load_pct = 100 - pct(idle - prev_idle, span);
+    out->dropped       = samples.overflow;
+    out->flush_isr_max_us = bsp_co5300_isr_max_us();
+
+    uint32_t irq = save_and_disable_interrupts();
+    out->vsync_period_us = vsync_n ? vsync_sum / vsync_n : 0;
+    out->vsync_missed    = vsync_missed;
+    out->headroom_avg_us = headroom_n ? headroom_sum / (int32_t)headroom_n : 0;
+    out->headroom_min_us = headroom_n ? headroom_min : 0;
+    vsync_n = vsync_sum = vsync_missed = 0;
+    headroom_n = 0;
+    headroom_sum = 0;
+    restore_interrupts(irq);
+
+    prev_t    = now;
+    prev_dma  = dma;
+    prev_idle = idle;
+    prev_area = area_px;
+    prev_sent = sent_px;
+}
+
+#endif /* ENABLE_RENDER_PERF */
@@ -0,0 +1,100 @@
+#ifndef RENDER_PERF_H
+#define RENDER_PERF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+/*
+ * Render performance counters (core 0)
+ *
+ * The display port stamps every LVGL refresh: start of rendering, time
+ * spent blocked on a busy flush buffer (wait_cb), and the end of the
+ * refresh with the number of invalidated pixels (monitor_cb).  Each
+ * refresh becomes one sample in a small ring.  Flush DMA busy time and
+ * the super-loop's WFE idle time are plain running totals.
+ *
+ * render_perf_get_stats() drains the ring and turns the samples and the
+ * totals into rates over the time since the previous call, so it is
+ * meant to be called from one periodic place (the debug console timer).
+ *
+ *   frame    render start → last area handed to the flush DMA
+ *   render   frame time minus time blocked waiting for a buffer
+ *   flush    DMA busy time, averaged per frame
+ *   link     pixel bytes sent per flush time: the achieved QSPI rate,
+ *            window setup and RAMWR commands included
+ *   px       flushed areas' pixels per frame, and the pixels actually
+ *            sent after the round-panel clip (DISP_ROUND_CLIP)
+ *
+ * With TE pacing (ENABLE_TE_SYNC) the paced vsync interrupt and the DMA
+ * of each refresh's last area add:
+ *
+ *   vsync    time between paced TE edges: the frame period
+ *   missed   paced edges that found the previous refresh still
+ *            rendering or flushing (the frame slipped a period)
+ *   headroom frame period minus vsync → last area read by the DMA;
+ *            negative when the refresh ran into the next period
+ */
+
+typedef struct {
+    uint32_t fps_x10;           /* refreshes per second × 10 */
+    uint32_t frames;            /* refreshes in this window */
+    uint32_t frame_avg_us;
+    uint32_t render_avg_us;
+    uint32_t render_max_us;
+    uint32_t flush_avg_us;      /* DMA per frame */
+    uint32_t flush_mbps_x10;    /* RGB565 bytes per µs of flush time × 10 */
+    uint32_t area_px_avg;       /* flushed area pixels per frame */
+    uint32_t sent_px_avg;       /* of those, sent to the panel */
+    uint32_t px_per_s;          /* invalidated pixels per second */
+    uint8_t  dma_pct;           /* flush DMA busy share */
+    uint8_t  core0_load_pct;    /* 100 - WFE idle share */
+    uint32_t dropped;           /* samples lost to a full ring */
+    uint32_t flush_isr_max_us;  /* flush-done interrupt, worst since boot */
+    uint32_t vsync_period_us;   /* paced TE period, 0 = no TE in this window */
+    uint32_t vsync_missed;      /* in this window */
+    int32_t  headroom_avg_us;
+    int32_t  headroom_min_us;
+} render_perf_stats_t;
+
+#if ENABLE_RENDER_PERF
+
+/* ---- LVGL display driver hooks ---- */
+void render_perf_frame_start(void);             /* render_start_cb */
+void render_perf_wait(uint32_t us);             /* time blocked in wait_cb */
+void render_perf_frame_end(uint32_t px);        /* monitor_cb */
+void render_perf_flush_start(uint32_t area_px,  /* flush_cb */
+                             uint32_t sent_px);
+void render_perf_flush_done(void);              /* its DMA done (ISR) */
+void render_perf_vsync(bool late);              /* paced TE edge (ISR) */
+void render_perf_frame_flushed(void);           /* last area's DMA done (ISR) */
+
+/* ---- Super-loop ---- */
+void render_perf_idle(uint32_t us);             /* time slept in WFE */
+
+/* Rates since the previous call (core 0) */
+void render_perf_get_stats(render_perf_stats_t *out);
+
+#else /* stubs — optimised away completely */
+
+static inline void render_perf_frame_start(void) {}
+static inline void render_perf_wait(uint32_t us) { (void)us; }
+static inline void render_perf_frame_end(uint32_t px) { (void)px; }
+static inline void render_perf_flush_start(uint32_t area_px, uint32_t sent_px)
+{ (void)area_px; (void)sent_px; }
+static inline void render_perf_flush_done(void) {}
+static inline void render_perf_vsync(bool late) { (void)late; }
+static inline void render_perf_frame_flushed(void) {}
+static inline void render_perf_idle(uint32_t us) { (void)us; }
+
+#endif /* ENABLE_RENDER_PERF */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RENDER_PERF_H */
@@ -4,42 +4,166 @@
 #include "hardware/irq.h"
 #include "hardware/clocks.h"
 #include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+#include "spsc_ring.h"
+#include "dlog.h"
+#include "trace_span.h"
 #include <string.h>
 
 static struct can2040 cbus;
 static volatile uint32_t irq_cnt = 0;
+static void (*rx_notify)(void);
+
+/* ---- Auto-baud state ---- */
+static const uint32_t autobaud_rates[] = { 500000, 250000, 125000, 1000000 };
+#define AUTOBAUD_RATE_COUNT (sizeof(autobaud_rates) / sizeof(autobaud_rates[0]))
+
+static volatile uint32_t locked_bitrate;    /* 0 while searching */
+static volatile bool     autobaud;          /* rate is being detected */
+static uint32_t try_order[AUTOBAUD_RATE_COUNT];
+static uint8_t  try_idx;
+static uint32_t try_start_us;
+static uint32_t try_rx0, try_err0;          /* stats at window start */
 
 /* ---- RX ring buffer (IRQ → main loop) ---- */
-#define CAN_RX_BUF_SIZE 32
-static bsp_can_frame_t rx_buf[CAN_RX_BUF_SIZE];
-static volatile uint8_t rx_head = 0;
-static uint8_t rx_tail = 0;
+SPSC_RING_DEFINE(static, rx_ring, bsp_can_frame_t, 32);
+
+/* ---- RX mailboxes (IRQ → main loop, newest frame per ID) ----
+ * The interrupt and the reader run on the same core, so the interrupt
+ * always completes a slot update before the reader resumes: `seq` is
+ * bumped after each write and the reader retries its copy if it moved.
+ * The reader's own last-seen `seq` tells how many frames were replaced
+ * unread. */
+#define MB_HASH_SIZE (2 * BSP_CAN_MAILBOX_COUNT)    /* power of two */
+
+typedef struct {
+    bsp_can_frame_t   frame;
+    volatile uint32_t seq;
+} can_mailbox_t;
+
+static can_mailbox_t     mb[BSP_CAN_MAILBOX_COUNT];
+static uint8_t           mb_count;                  /* 0 = FIFO mode */
+static uint8_t           mb_hash[MB_HASH_SIZE];     /* slot + 1, 0 = empty */
+static volatile uint32_t mb_dirty;                  /* slots written */
+static volatile uint32_t mb_filtered;
+
+static uint32_t mb_pending;                         /* taken, not yet read */
+static uint32_t mb_last_seq[BSP_CAN_MAILBOX_COUNT];
+static uint32_t mb_overwrite[BSP_CAN_MAILBOX_COUNT];
+
+static inline uint32_t hash_id(uint32_t id)
+{
+    return ((id * 0x9E3779B1u) >> 16) & (MB_HASH_SIZE - 1);
+}
+
+static int mb_lookup(uint32_t id)
+{
+    uint32_t h = hash_id(id);
+    uint8_t  e;
+    while ((e = mb_hash[h]) != 0) {
+        if (mb[e - 1].frame.id == id)
+            return e - 1;
+        h = (h + 1) & (MB_HASH_SIZE - 1);
+    }
+    return -1;
+}
 
 /* ---- can2040 RX callback (IRQ context) ---- */
 static void can_rx_cb(struct can2040 *cd, uint32_t notify,
                        struct can2040_msg *msg)
 {
-    if (notify == CAN2040_NOTIFY_RX) {
-        uint8_t next = (rx_head + 1) % CAN_RX_BUF_SIZE;
-        if (next != rx_tail) {
-            rx_buf[rx_head].id  = msg->id;
-            rx_buf[rx_head].dlc = (uint8_t)msg->dlc;
-            memcpy(rx_buf[rx_head].data, msg->data, 8);
-            rx_head = next;
+    if (notify != CAN2040_NOTIFY_RX) {
+        if (notify == CAN2040_NOTIFY_ERROR)
+            DLOG_DEBUG("can: rx error");
+        return;
+    }
+
+    if (mb_count != 0) {
+        int i = mb_lookup(msg->id);
+        if (i < 0) {
+            mb_filtered++;
+            return;
         }
+        mb[i].frame.dlc = (uint8_t)msg->dlc;
+        mb[i].frame.rx_us = time_us_32();
+        memcpy(mb[i].frame.data, msg->data, 8);
+        mb[i].seq++;
+        mb_dirty |= 1u << i;
+        if (rx_notify) rx_notify();
+        return;
+    }
+
+    void *span;
+    if (spsc_ring_write_span(&rx_ring, &span, NULL) == 0) {
+        rx_ring.overflow++;
+        DLOG_WARN("can: rx ring full, id 0x%x dropped", msg->id);
+        return;
     }
+    bsp_can_frame_t *slot = (bsp_can_frame_t *)span;
+    slot->id  = msg->id;
+    slot->dlc = (uint8_t)msg->dlc;
+    slot->rx_us = time_us_32();
+    memcpy(slot->data, msg->data, 8);
+    spsc_ring_produce(&rx_ring, 1);
+    if (rx_notify) rx_notify();
 }
 
 /* ---- PIO IRQ trampoline — kept out of flash for XIP safety ---- */
 static void __not_in_flash_func(can_pio_irq_handler)(void)
 {
+    TRACE_BEGIN("can_irq");
     irq_cnt++;
     can2040_pio_irq_handler(&cbus);
+    TRACE_END("can_irq");
+}
+
+/* ---- Auto-baud ---- */
+
+static void start_at(uint32_t bitrate)
+{
+    can2040_stop(&cbus);
+    can2040_start(&cbus, clock_get_hz(clk_sys), bitrate,
+                  BSP_CAN_GPIO_RX, BSP_CAN_GPIO_TX);
+}
+
+static void autobaud_try(uint8_t idx)
+{
+    struct can2040_stats st;
+
+    try_idx = idx;
+    DLOG_DEBUG("can: auto-baud trying %u bit/s", try_order[idx]);
+    start_at(try_order[idx]);
+    can2040_get_statistics(&cbus, &st);
+    try_rx0      = st.rx_total;
+    try_err0     = st.parse_error;
+    try_start_us = time_us_32();
+}
+
+/* Evaluate the current candidate; lock it or move on to the next one */
+static void autobaud_step(void)
+{
+    struct can2040_stats st;
+    can2040_get_statistics(&cbus, &st);
+
+    uint32_t rx  = st.rx_total - try_rx0;
+    uint32_t err = st.parse_error - try_err0;
+
+    if (err == 0 && rx >= BSP_CAN_AUTOBAUD_MIN_FRAMES) {
+        locked_bitrate = try_order[try_idx];
+        DLOG_INFO("can: auto-baud locked at %u bit/s", locked_bitrate);
+        return;
+    }
+
+    bool expired = time_us_32() - try_start_us >=
+                   BSP_CAN_AUTOBAUD_WINDOW_MS * 1000u;
+    if (expired || (rx == 0 && err >= BSP_CAN_AUTOBAUD_MAX_ERRORS))
+        autobaud_try((uint8_t)((try_idx + 1) % AUTOBAUD_RATE_COUNT));
 }
 
 /* ---- Public API ---- */
 
-void bsp_can_init(void)
+void bsp_can_init(uint32_t bitrate, uint32_t hint)
 {
     /* SN65HVD230 Rs pin: 10k pull-down keeps ~1.5V (slope control, active).
        Leave it alone — same as InventEmu. */
@@ -52,8 +176,29 @@ void bsp_can_init(void)
     irq_set_priority(pio_irq, 0);
     irq_set_enabled(pio_irq, true);
 
-    can2040_start(&cbus, clock_get_hz(clk_sys), BSP_CAN_BITRATE,
-                  BSP_CAN_GPIO_RX, BSP_CAN_GPIO_TX);
+    if (bitrate != BSP_CAN_BITRATE_AUTO && !bsp_can_bitrate_valid(bitrate)) {
+        DLOG_WARN("can: %u bit/s is not a standard rate, auto-baud", bitrate);
+        bitrate = BSP_CAN_BITRATE_AUTO;
+    }
+    autobaud = bitrate == BSP_CAN_BITRATE_AUTO;
+    if (!autobaud) {
+        locked_bitrate = bitrate;
+        start_at(bitrate);
+        return;
+    }
+
+    /* Candidate order: the hint (if it is a standard rate), then the rest */
+    if (hint == 0) hint = BSP_CAN_BITRATE;
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < AUTOBAUD_RATE_COUNT; i++)
+        if (autobaud_rates[i] == hint)
+            try_order[n++] = hint;
+    for (uint8_t i = 0; i < AUTOBAUD_RATE_COUNT; i++)
+        if (autobaud_rates[i] != hint)
+            try_order[n++] = autobaud_rates[i];
+
+    locked_bitrate = 0;
+    autobaud_try(0);
 }
 
 bsp_can_stats_t bsp_can_get_stats(void)
@@ -70,13 +215,96 @@ bsp_can_stats_t bsp_can_get_stats(void)
     st.irq_count   = irq_cnt;
     st.connected   = (raw.rx_total > 0);
     st.err_state   = raw.parse_error_state;
+    st.bitrate     = locked_bitrate;
+    st.rx_dropped  = rx_ring.overflow;
+    st.rx_high_water = rx_ring.high_water;
+    st.rx_filtered = mb_filtered;
+    st.mailbox_count = mb_count;
+    memcpy(st.mb_overwrite, mb_overwrite, sizeof(st.mb_overwrite));
     return st;
 }
 
-bool bsp_can_recv(bsp_can_frame_t *frame)
+void bsp_can_set_rx_notify(void (*cb)(void))
 {
-    if (rx_tail == rx_head) return false;
-    *frame = rx_buf[rx_tail];
-    rx_tail = (rx_tail + 1) % CAN_RX_BUF_SIZE;
+    rx_notify = cb;
+}
+
+bool bsp_can_set_mailboxes(const uint32_t *ids, uint8_t count)
+{
+    if (count > BSP_CAN_MAILBOX_COUNT)
+        return false;
+
+    memset(mb_hash, 0, sizeof(mb_hash));
+    for (uint8_t i = 0; i < count; i++) {
+        mb[i].frame.id = ids[i];
+        uint32_t h = hash_id(ids[i]);
+        while (mb_hash[h] != 0)
+            h = (h + 1) & (MB_HASH_SIZE - 1);
+        mb_hash[h] = i + 1;
+    }
+    mb_count = count;
     return true;
 }
+
+/* Newest frame of the next dirty mailbox */
+static bool mailbox_recv(bsp_can_frame_t *frame)
+{
+    for (;;) {
+        if (mb_pending == 0) {
+            uint32_t irq = save_and_disable_interrupts();
+            mb_pending = mb_dirty;
+            mb_dirty = 0;
+            restore_interrupts(irq);
+            if (mb_pending == 0)
+                return false;
+        }
+
+        unsigned i = (unsigned)__builtin_ctz(mb_pending);
+        mb_pending &= mb_pending - 1;
+
+        uint32_t seq;
+        do {
+            seq = mb[i].seq;
+            __compiler_memory_barrier();
+            *frame = mb[i].frame;
+            __compiler_memory_barrier();
+        } while (seq != mb[i].seq);
+
+        /* A slot rewritten during the copy is flagged dirty again but
+         * was already returned at its newest seq */
+        if (seq == mb_last_seq[i])
+            continue;
+        mb_overwrite[i] += seq - mb_last_seq[i] - 1;
+        mb_last_seq[i] = seq;
+        return true;
+    }
+}
+
+bool bsp_can_recv(bsp_can_frame_t *frame)
+{
+    if (locked_bitrate == 0)
+        autobaud_step();
+
+    if (mb_count != 0)
+        return mailbox_recv(frame);
+
+    return spsc_ring_pop(&rx_ring, frame, 1) == 1;
+}
+
+uint32_t bsp_can_bitrate(void)
+{
+    return locked_bitrate;
+}
+
+bool bsp_can_autobaud(void)
+{
+    return autobaud;
+}
+
+bool bsp_can_bitrate_valid(uint32_t bitrate)
+{
+    for (uint8_t i = 0; i < AUTOBAUD_RATE_COUNT; i++)
+        if (autobaud_rates[i] == bitrate)
+            return true;
+    return false;
+}
@@ -5,15 +5,31 @@
 #include <stdbool.h>
 
 #define BSP_CAN_PIO_NUM   0
-#define BSP_CAN_BITRATE   500000
+#define BSP_CAN_BITRATE   500000    /* ME442 factory rate, auto-baud tries it first */
 #define BSP_CAN_GPIO_TX   21
 #define BSP_CAN_GPIO_RX   22
 #define BSP_CAN_GPIO_SLP  23
 
+/*
+ * RX modes
+ *
+ * FIFO (default): every frame is queued (32 deep) and frames arriving
+ * while the queue is full are dropped.
+ *
+ * Mailbox: bsp_can_set_mailboxes() lists the IDs of interest before
+ * bsp_can_init().  The RX interrupt discards every other ID through a
+ * small hash filter and overwrites one slot per ID with the newest
+ * frame; bsp_can_recv() then returns only the slots that changed since
+ * they were last read.  Nothing can overflow at any bus load — a frame
+ * replaced before it was read only counts in mb_overwrite[slot].
+ */
+#define BSP_CAN_MAILBOX_COUNT 16
+
 typedef struct {
     uint32_t id;
     uint8_t  data[8];
     uint8_t  dlc;
+    uint32_t rx_us;         /* time_us_32() in the RX interrupt */
 } bsp_can_frame_t;
 
 typedef struct {
@@ -26,12 +42,53 @@ typedef struct {
     bool     connected;
     uint8_t  rx_pin_raw;   /* live GPIO22 state: 1=recessive, 0=dominant */
     uint32_t err_state;    /* last parse_state that caused parse_error */
+    uint32_t bitrate;      /* active bit rate, 0 while auto-baud searches */
+    uint32_t rx_dropped;   /* FIFO mode: frames lost to a full queue */
+    uint32_t rx_high_water;/* FIFO mode: deepest the queue has been */
+    uint32_t rx_filtered;  /* mailbox mode: frames with an unlisted ID */
+    uint8_t  mailbox_count;                     /* 0 = FIFO mode */
+    uint32_t mb_overwrite[BSP_CAN_MAILBOX_COUNT]; /* per mailbox slot */
 } bsp_can_stats_t;
 
-void bsp_can_init(void);
+/*
+ * Auto-baud: pass BSP_CAN_BITRATE_AUTO to bsp_can_init().  The standard
+ * rates are tried in turn (`hint` first, e.g. the rate found last time),
+ * each for up to BSP_CAN_AUTOBAUD_WINDOW_MS.  A rate is locked as soon
+ * as it has produced BSP_CAN_AUTOBAUD_MIN_FRAMES valid frames and no
+ * parse error; a rate that only yields parse errors is abandoned early.
+ * The search is stepped from bsp_can_recv(), so it never blocks.
+ *
+ * The search is passive: can2040 only drives the bus to ACK a frame
+ * whose CRC matched, which does not happen at a wrong bit rate.
+ */
+#define BSP_CAN_BITRATE_AUTO          0
+#define BSP_CAN_AUTOBAUD_WINDOW_MS    120
+#define BSP_CAN_AUTOBAUD_MIN_FRAMES   2
+#define BSP_CAN_AUTOBAUD_MAX_ERRORS   4     /* with no frame: wrong rate */
+
+void bsp_can_init(uint32_t bitrate, uint32_t hint);
 bsp_can_stats_t bsp_can_get_stats(void);
 
 /* Returns true and fills *frame if a frame is available */
 bool bsp_can_recv(bsp_can_frame_t *frame);
 
+/* Called from the RX interrupt after each frame is queued (or stored in
+ * its mailbox) — e.g. to release the task that drains them */
+void bsp_can_set_rx_notify(void (*cb)(void));
+
+/* Switch to mailbox mode for `ids` (slot i = ids[i]); call before
+ * bsp_can_init().  Returns false, staying in FIFO mode, if there are
+ * more IDs than BSP_CAN_MAILBOX_COUNT. */
+bool bsp_can_set_mailboxes(const uint32_t *ids, uint8_t count);
+
+/* Locked bit rate, 0 while auto-baud is still searching */
+uint32_t bsp_can_bitrate(void);
+
+/* True if bsp_can_bitrate() comes from auto-baud, not a fixed rate */
+bool bsp_can_autobaud(void);
+
+/* True for the standard rates auto-baud tries (125k/250k/500k/1M); any
+ * other fixed rate given to bsp_can_init() falls back to auto-baud */
+bool bsp_can_bitrate_valid(uint32_t bitrate);
+
 #endif /* __BSP_CAN_H__ */
@@ -3,31 +3,164 @@
  *
  * Drives a 466x466 circular AMOLED panel via PIO2 QSPI.
  *
- * Command path (register writes, window setup):
- *   CS LOW → 1-bit SPI blocking write → CS HIGH
+ * CS is driven by the PIO program: every write below is a transaction
+ * the state machine frames on its own.
  *
- * Pixel flush path (DMA, non-blocking):
- *   set_window(CASET + RASET) → CS LOW → RAMWR cmd (1-bit) →
- *   pixel data (4-bit QSPI DMA) → DMA ISR → wait_idle → CS HIGH →
- *   lv_disp_flush_ready()
+ * Command path (init sequence, register writes):
+ *   1-bit SPI blocking write
  *
- * Brightness is deferred: if a brightness change is requested while a
- * DMA flush is in progress, it is applied in the DMA-done callback
- * after CS is released.
+ * Pixel flush path (one DMA list, non-blocking, no CPU until the end):
+ *   CASET (1-bit) → RASET (1-bit) → RAMWR prefix (1-bit) + pixel data
+ *   (4-bit) → end-of-list IRQ → lv_disp_flush_ready()
+ *
+ * The three commands live pre-expanded in a static descriptor; a flush
+ * only rewrites the eight coordinate words and the RAMWR length, then
+ * starts a list: queued commands, descriptor, pixel buffer, end.
+ *
+ * flush_dma_spans() sends parts of the area only (the round panel's
+ * visible circle): one descriptor per span, and the span's pixels read
+ * straight out of the area buffer, one block per row where the span is
+ * narrower than the buffer.  The row blocks of a span all feed one RAMWR
+ * transaction.  flush_dma() is the one-span case.  The
+ * interrupt fires once the DMA has read the last pixel, so LVGL gets the
+ * buffer back while the PIO is still shifting out the last FIFO words;
+ * the next area's list queues behind them under its own CS frame.
+ *
+ * Runtime commands (brightness, sleep in/out) go through a small queue
+ * instead of the bus: they are expanded in thread context and ride
+ * ahead of the next flush, or go out as a command-only list from
+ * poll() when nothing is being drawn.  Nothing in interrupt context
+ * touches the bus; the end-of-list handler only signals LVGL.
+ *
+ * The panel pulses TE once per scan, at the line set by command 0x44
+ * (471: past the 466 visible lines, in the vertical porch).  With a
+ * te_cb in the display info the rising edge is passed on from a raw GPIO
+ * handler, which leaves the shared GPIO callback to the touch driver.
  */
 
 #include "bsp_co5300.h"
 #include <stdio.h>
 #include <string.h>
 #include "pico/stdlib.h"
+#include "hardware/irq.h"
 #include "hardware/spi.h"
 #include "pio_qspi.h"
+#include "trace_span.h"
+#include "dlog.h"
+#include "spsc_ring.h"
 
 /* ---- State ---- */
 
 static bsp_display_interface_t *g_display_if;
 static bsp_display_info_t      *g_display_info;
-static bool                     g_set_brightness_flag = false;
+static volatile uint32_t        g_isr_max_us;
+
+/* ---- Flush descriptor ----
+ *
+ * Data words exactly as the DMA sends them (see pio_qspi.h):
+ * a transaction header, then one word per 1-bit byte.
+ */
+
+typedef struct {
+    uint32_t caset[1 + 8];      /* 02 00 2A 00  xs xs xe xe */
+    uint32_t raset[1 + 8];      /* 02 00 2B 00  ys ys ye ye */
+    uint32_t ramwr[1 + 4];      /* 32 00 2C 00, the pixels follow */
+} window_desc_t;
+
+#define WINDOW_DESC_WORDS   (sizeof(window_desc_t) / sizeof(uint32_t))
+
+#define PANEL_ROWS      466
+#define LIST_LEN        (2 + BSP_CO5300_MAX_SPANS + \
+                         (PANEL_ROWS > BSP_CO5300_MAX_SPANS ? \
+                          PANEL_ROWS : BSP_CO5300_MAX_SPANS))
+
+static window_desc_t    window_desc[BSP_CO5300_MAX_SPANS];
+/* cmds, then per span its window and one block per row (or one for the
+ * whole span), end */
+static pio_qspi_block_t list[LIST_LEN];
+static volatile bool    list_busy;          /* until its end-of-list IRQ */
+static bool             list_has_pixels;
+
+static void window_desc_init(void)
+{
+    static const uint8_t caset[] = { 0x02, 0x00, 0x2A, 0x00 };
+    static const uint8_t raset[] = { 0x02, 0x00, 0x2B, 0x00 };
+    static const uint8_t ramwr[] = { 0x32, 0x00, 0x2C, 0x00 };
+
+    for (int d = 0; d < BSP_CO5300_MAX_SPANS; d++) {
+        window_desc_t *w = &window_desc[d];
+        w->caset[0] = pio_qspi_header(8);
+        w->raset[0] = pio_qspi_header(8);
+        for (int i = 0; i < 4; i++) {
+            w->caset[1 + i] = pio_qspi_expand_1bit(caset[i]);
+            w->raset[1 + i] = pio_qspi_expand_1bit(raset[i]);
+            w->ramwr[1 + i] = pio_qspi_expand_1bit(ramwr[i]);
+        }
+    }
+}
+
+/** Expanded big-endian start/end pair into 4 descriptor words. */
+static inline void put_pair(uint32_t *w, uint16_t start, uint16_t end)
+{
+    w[0] = pio_qspi_expand_1bit(start >> 8);
+    w[1] = pio_qspi_expand_1bit(start & 0xFF);
+    w[2] = pio_qspi_expand_1bit(end >> 8);
+    w[3] = pio_qspi_expand_1bit(end & 0xFF);
+}
+
+/* ---- Command queue ----
+ *
+ * Producer: the interface calls (thread context).  Consumer: flush_dma()
+ * and poll(), also thread context.  A command with a delay (sleep out
+ * needs 120 ms) holds back the commands behind it, not the pixels.
+ */
+
+#define CMD_QUEUE_LEN   8
+#define CMD_MAX_DATA    4
+#define CMD_WORDS_MAX   (CMD_QUEUE_LEN * (1 + 4 + CMD_MAX_DATA))
+
+typedef struct {
+    uint8_t  reg;
+    uint8_t  data_bytes;
+    uint8_t  data[CMD_MAX_DATA];
+    uint16_t delay_ms;
+} queued_cmd_t;
+
+SPSC_RING_DEFINE(static, cmd_queue, queued_cmd_t, CMD_QUEUE_LEN);
+
+static uint32_t        cmd_words[CMD_WORDS_MAX];
+static absolute_time_t cmd_hold_until;
+
+static void queue_cmd(uint8_t reg, const uint8_t *data, uint8_t data_bytes,
+                      uint16_t delay_ms)
+{
+    queued_cmd_t c = { .reg = reg, .data_bytes = data_bytes,
+                       .delay_ms = delay_ms };
+    if (data_bytes)
+        memcpy(c.data, data, data_bytes);
+    if (spsc_ring_push(&cmd_queue, &c, 1) == 0)
+        DLOG_WARN("co5300: command queue full, 0x%02x dropped", reg);
+}
+
+/** Expand due commands into cmd_words[]; returns the word count. */
+static uint32_t expand_queued(void)
+{
+    uint32_t n = 0;
+    queued_cmd_t c;
+
+    while (time_reached(cmd_hold_until) &&
+           spsc_ring_pop(&cmd_queue, &c, 1) == 1) {
+        const uint8_t prefix[4] = { 0x02, 0x00, c.reg, 0x00 };
+        cmd_words[n++] = pio_qspi_header(4 + c.data_bytes);
+        for (int i = 0; i < 4; i++)
+            cmd_words[n++] = pio_qspi_expand_1bit(prefix[i]);
+        for (int i = 0; i < c.data_bytes; i++)
+            cmd_words[n++] = pio_qspi_expand_1bit(c.data[i]);
+        if (c.delay_ms)
+            cmd_hold_until = make_timeout_time_ms(c.delay_ms);
+    }
+    return n;
+}
 
 /* ---- Command transmission ---- */
 
@@ -55,9 +188,7 @@ static void tx_param(oled_cmd_t *cmds, size_t count)
         for (size_t j = 0; j < cmds[i].data_bytes; j++)
             pkt[4 + j] = cmds[i].data[j];
 
-        gpio_put(BSP_OLED_CS_PIN, 0);
         pio_qspi_1bit_write_data_blocking(pkt, 4 + cmds[i].data_bytes);
-        gpio_put(BSP_OLED_CS_PIN, 1);
 
         if (cmds[i].delay_ms > 0)
             sleep_ms(cmds[i].delay_ms);
@@ -67,31 +198,46 @@ static void tx_param(oled_cmd_t *cmds, size_t count)
 /* ---- DMA completion ISR callback ---- */
 
 /**
- * Called from DMA IRQ when a pixel flush transfer completes.
+ * Called from DMA IRQ when a list has been read out completely.
  * Must run in ISR context (registered on DMA_IRQ_1 via bsp_dma_channel_irq).
  *
- * Ordering is critical: wait for PIO shift register to drain, then
- * release CS *before* signalling LVGL that the buffer is free.
+ * The pixel buffer is free now; the PIO finishes the transaction (and
+ * raises CS) on its own.  Its run time is tracked as a worst case.
  */
 static void __no_inline_not_in_flash_func(flush_dma_done_cb)(void)
 {
-    pio_qspi_wait_idle();
-    gpio_put(BSP_OLED_CS_PIN, 1);
+    uint32_t t0 = time_us_32();
+    TRACE_END_ON(TRACE_TRACK_DMA, "qspi_dma");
+    TRACE_BEGIN("flush_dma_done_cb");
 
-    if (g_display_info->dma_flush_done_cb)
+    list_busy = false;
+    if (list_has_pixels && g_display_info->dma_flush_done_cb)
         g_display_info->dma_flush_done_cb();
 
-    /* Apply deferred brightness change now that CS is free */
-    if (g_set_brightness_flag) {
-        g_set_brightness_flag = false;
-        uint8_t level = 0x25 + g_display_info->brightness * (0xFF - 0x25) / 100;
-        oled_cmd_t cmd = {
-            .reg = 0x51, .data = &level, .data_bytes = 1, .delay_ms = 0,
-        };
-        tx_param(&cmd, 1);
+    TRACE_END("flush_dma_done_cb");
+    uint32_t us = time_us_32() - t0;
+    if (us > g_isr_max_us)
+        g_isr_max_us = us;
+}
+
+/** TE rising edge: the panel scan has just left the visible area. */
+static void __not_in_flash_func(te_irq_handler)(void)
+{
+    if (gpio_get_irq_event_mask(BSP_OLED_TE_PIN) & GPIO_IRQ_EDGE_RISE) {
+        gpio_acknowledge_irq(BSP_OLED_TE_PIN, GPIO_IRQ_EDGE_RISE);
+        g_display_info->te_cb();
     }
 }
 
+/** Start list[] (thread context; the previous list has completed). */
+static void start_list(bool has_pixels)
+{
+    list_has_pixels = has_pixels;
+    list_busy = true;
+    TRACE_BEGIN_ON(TRACE_TRACK_DMA, "qspi_dma");
+    pio_qspi_start_list(list);
+}
+
 /* ---- Interface implementation ---- */
 
 static void set_rotation(uint16_t rotation)
@@ -106,23 +252,59 @@ static void set_brightness(uint8_t brightness)
     if (brightness > 100)
         brightness = 100;
     g_display_info->brightness = brightness;
-    g_set_brightness_flag = true;
+
+    uint8_t level = 0x25 + brightness * (0xFF - 0x25) / 100;
+    queue_cmd(0x51, &level, 1, 0);
+}
+
+static void set_sleep(bool sleep)
+{
+    /* Sleep in needs 5 ms, sleep out 120 ms before the next command */
+    if (sleep)
+        queue_cmd(0x10, NULL, 0, 5);
+    else
+        queue_cmd(0x11, NULL, 0, 120);
+}
+
+/** Takes effect with the next flush: the offsets are part of its window. */
+static void set_offset(uint16_t x_offset, uint16_t y_offset)
+{
+    g_display_info->x_offset = x_offset;
+    g_display_info->y_offset = y_offset;
+}
+
+/** Send queued commands when no flush is around to carry them. */
+static void poll(void)
+{
+    if (list_busy || spsc_ring_empty(&cmd_queue))
+        return;
+    uint32_t n = expand_queued();
+    if (n == 0)
+        return;                     /* held back by a delay */
+    list[0] = (pio_qspi_block_t){ n, cmd_words };
+    list[1] = (pio_qspi_block_t){ 0, NULL };
+    start_list(false);
 }
 
 static void init(void)
 {
-    /* GPIO setup for CS, RST, and panel power */
-    gpio_init(BSP_OLED_CS_PIN);
+    /* GPIO setup for RST and panel power (CS belongs to the PIO) */
     gpio_init(BSP_OLED_RST_PIN);
     gpio_init(BSP_OLED_PWR_PIN);
 
-    gpio_set_dir(BSP_OLED_CS_PIN,  GPIO_OUT);
     gpio_set_dir(BSP_OLED_RST_PIN, GPIO_OUT);
     gpio_set_dir(BSP_OLED_PWR_PIN, GPIO_OUT);
     gpio_put(BSP_OLED_PWR_PIN, 1);
 
-    pio_qspi_init(BSP_OLED_SCLK_PIN, BSP_OLED_D0_PIN,
-                   75 * 1000 * 1000, flush_dma_done_cb);
+    /* 80 MHz at a 240 MHz system clock (divider 1).  Every SCLK period
+     * is 12.5 ns; the old fractional 75 MHz setting averaged 13.3 ns
+     * but had single periods as short as 8.3 ns. */
+    uint32_t sclk = pio_qspi_init(BSP_OLED_SCLK_PIN, BSP_OLED_D0_PIN,
+                                  BSP_OLED_CS_PIN, 80 * 1000 * 1000,
+                                  flush_dma_done_cb);
+    window_desc_init();
+    DLOG_INFO("co5300: qspi sclk %u kHz, %u kB/s peak",
+              sclk / 1000, sclk / 2 / 1000);
 
     /* Hardware reset */
     gpio_put(BSP_OLED_RST_PIN, 0);
@@ -145,12 +327,22 @@ static void init(void)
     };
     tx_param(init_cmds, sizeof(init_cmds) / sizeof(init_cmds[0]));
 
+    /* TE edges on this core's IO_IRQ_BANK0 */
+    if (g_display_info->te_cb) {
+        gpio_init(BSP_OLED_TE_PIN);
+        gpio_set_dir(BSP_OLED_TE_PIN, GPIO_IN);
+        gpio_add_raw_irq_handler(BSP_OLED_TE_PIN, te_irq_handler);
+        gpio_set_irq_enabled(BSP_OLED_TE_PIN, GPIO_IRQ_EDGE_RISE, true);
+        irq_set_enabled(IO_IRQ_BANK0, true);
+    }
+
     set_brightness(g_display_info->brightness);
 }
 
 /**
- * Program the CO5300 column and row address window (CASET + RASET).
- * Called before every pixel data transfer.
+ * Program the CO5300 column and row address window (CASET + RASET),
+ * blocking.  Flushes carry their own window (see flush_dma); this is
+ * for interface users outside the LVGL flush path.
  */
 static void set_window(bsp_display_area_t *area)
 {
@@ -180,26 +372,89 @@ static void get_brightness(uint8_t *brightness)
 }
 
 /**
- * Start a non-blocking DMA pixel flush.
+ * Start a non-blocking DMA flush of parts of an area and return at once.
+ *
+ * Per span, fills in a window descriptor (CASET, RASET, RAMWR length)
+ * and adds it to the list followed by the span's pixels in 4-bit QSPI
+ * mode; due queued commands go first, or alone ahead of the frame when
+ * one of them starts a delay.  The end-of-list ISR
+ * (flush_dma_done_cb) signals LVGL.  Called only after the previous
+ * flush's callback, so the descriptors are free to rewrite.
  *
- * Sends set_window, then the RAMWR command (0x2C) in 1-bit SPI mode,
- * followed by the pixel buffer in 4-bit QSPI mode via DMA.  The DMA
- * completion ISR (flush_dma_done_cb) handles CS release and signals
- * LVGL.
+ * The LVGL rounder makes every side even, and so must the spans: each
+ * span row is whole words at a word-aligned offset in the buffer.
  */
-static void flush_dma(bsp_display_area_t *area, uint16_t *color_p)
+static void flush_dma_spans(bsp_display_area_t *area, uint16_t *color_p,
+                            const bsp_display_area_t *spans, uint16_t count)
 {
-    size_t pixel_count = (area->x2 - area->x1 + 1) *
-                         (area->y2 - area->y1 + 1);
-    set_window(area);
+    /* Only a command-only list from poll() can still be running: a few
+     * dozen words, microseconds of DMA */
+    while (list_busy)
+        tight_loop_contents();
+
+    if (count > BSP_CO5300_MAX_SPANS) {
+        DLOG_WARN("co5300: %u spans, sending the whole area", count);
+        spans = area;
+        count = 1;
+    }
 
-    /* RAMWR command header (0x32 = QSPI write prefix, 0x2C = RAMWR) */
-    uint8_t ramwr_cmd[] = { 0x32, 0x00, 0x2C, 0x00 };
-    gpio_put(BSP_OLED_CS_PIN, 0);
-    pio_qspi_1bit_write_data_blocking(ramwr_cmd, 4);
+    /* No window or pixel write inside a command's delay (120 ms after
+     * sleep out): the commands go out alone and the frame waits.  LVGL
+     * is blocked on this flush either way. */
+    uint32_t n = expand_queued();
+    while (!time_reached(cmd_hold_until)) {
+        if (n) {
+            list[0] = (pio_qspi_block_t){ n, cmd_words };
+            list[1] = (pio_qspi_block_t){ 0, NULL };
+            start_list(false);
+            while (list_busy)
+                tight_loop_contents();
+        }
+        sleep_until(cmd_hold_until);
+        n = expand_queued();
+    }
 
-    /* Pixel data via 4-bit QSPI DMA (non-blocking) */
-    pio_qspi_4bit_write_data((uint8_t *)color_p, pixel_count * 2);
+    uint32_t stride = (area->x2 - area->x1 + 1) / 2;   /* words per row */
+    const uint32_t *pixels = (const uint32_t *)color_p;
+
+    int b = 0;
+    if (n)
+        list[b++] = (pio_qspi_block_t){ n, cmd_words };
+
+    for (uint16_t i = 0; i < count; i++) {
+        const bsp_display_area_t *s = &spans[i];
+        window_desc_t *d = &window_desc[i];
+        uint32_t words = (s->x2 - s->x1 + 1) / 2;
+        uint32_t rows  = s->y2 - s->y1 + 1;
+
+        put_pair(&d->caset[5], s->x1 + g_display_info->x_offset,
+                 s->x2 + g_display_info->x_offset);
+        put_pair(&d->raset[5], s->y1 + g_display_info->y_offset,
+                 s->y2 + g_display_info->y_offset);
+        d->ramwr[0] = pio_qspi_header(4 + words * rows);
+        list[b++] = (pio_qspi_block_t){ WINDOW_DESC_WORDS, d };
+
+        const uint32_t *row = pixels + (s->y1 - area->y1) * stride +
+                              (s->x1 - area->x1) / 2;
+        if (words == stride) {
+            list[b++] = (pio_qspi_block_t){ words * rows, row };
+        } else {
+            for (uint32_t r = 0; r < rows; r++, row += stride)
+                list[b++] = (pio_qspi_block_t){ words, row };
+        }
+    }
+    list[b] = (pio_qspi_block_t){ 0, NULL };
+    start_list(true);
+}
+
+static void flush_dma(bsp_display_area_t *area, uint16_t *color_p)
+{
+    flush_dma_spans(area, color_p, area, 1);
+}
+
+uint32_t bsp_co5300_isr_max_us(void)
+{
+    return g_isr_max_us;
 }
 
 /* ---- Constructor ---- */
@@ -219,11 +474,15 @@ bool bsp_display_new_co5300(bsp_display_interface_t **interface,
     display_if.reset          = NULL;       /* reset is part of init */
     display_if.set_rotation   = set_rotation;
     display_if.set_brightness = set_brightness;
+    display_if.set_sleep      = set_sleep;
+    display_if.set_offset     = set_offset;
+    display_if.poll           = poll;
     display_if.set_window     = set_window;
     display_if.get_brightness = get_brightness;
     display_if.get_rotation   = get_rotation;
     display_if.flush          = NULL;       /* blocking flush not used */
     display_if.flush_dma      = flush_dma;
+    display_if.flush_dma_spans = flush_dma_spans;
 
     *interface     = &display_if;
     g_display_if   = &display_if;
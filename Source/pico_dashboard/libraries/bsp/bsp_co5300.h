@@ -17,7 +17,24 @@
 
 #define BSP_OLED_PWR_PIN        19
 
+/* Tearing-effect output of the panel.  GPIO 18 is the one free pin of the
+ * display group, not a confirmed TE route; override if the module wires
+ * TE elsewhere.  A missing TE signal is detected by the display port,
+ * which then goes back to plain timer pacing. */
+#ifndef BSP_OLED_TE_PIN
+#define BSP_OLED_TE_PIN         18
+#endif
+
+
+/* Spans per flush_dma_spans() call; each has its own window descriptor
+ * (92 bytes) */
+#ifndef BSP_CO5300_MAX_SPANS
+#define BSP_CO5300_MAX_SPANS    32
+#endif
 
 bool bsp_display_new_co5300(bsp_display_interface_t **interface, bsp_display_info_t *info);
 
+/* Longest run of the end-of-list DMA interrupt handler since boot, µs */
+uint32_t bsp_co5300_isr_max_us(void);
+
 #endif // __BSP_CO5300_H__
\ No newline at end of file
@@ -14,6 +14,7 @@ typedef struct
     uint8_t brightness;
     uint dma_tx_channel;
     channel_irq_callback_t dma_flush_done_cb;
+    channel_irq_callback_t te_cb;       /* TE rising edge (ISR), NULL = unused */
 }bsp_display_info_t;
 
 typedef struct {
@@ -33,7 +34,9 @@ struct bsp_display_interface_t {
    void (*reset)(void);
 
    void (*set_rotation)(uint16_t rotation);
-   void (*set_brightness)(uint8_t brightness);
+   void (*set_brightness)(uint8_t brightness);   /* queued */
+   void (*set_sleep)(bool sleep);                /* queued */
+   void (*set_offset)(uint16_t x_offset, uint16_t y_offset);
 
    void (*set_window)(bsp_display_area_t *area);
    
@@ -42,6 +45,14 @@ struct bsp_display_interface_t {
 
    void (*flush)(bsp_display_area_t *area, uint16_t *color_p);
    void (*flush_dma)(bsp_display_area_t *area, uint16_t *color_p);
+   /* Send only `spans` of the area's pixel buffer: sub-rectangles of
+    * area, top to bottom, no two sharing a row.  No spans still
+    * completes the flush. */
+   void (*flush_dma_spans)(bsp_display_area_t *area, uint16_t *color_p,
+                           const bsp_display_area_t *spans, uint16_t count);
+
+   /* Send queued commands if no flush is carrying them (thread context) */
+   void (*poll)(void);
 };
 
 
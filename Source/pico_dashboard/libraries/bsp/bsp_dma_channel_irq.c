@@ -1,6 +1,7 @@
 #include "bsp_dma_channel_irq.h"
 #include "hardware/irq.h"
 #include "hardware/dma.h"
+#include "dlog.h"
 
 typedef struct
 {
@@ -30,7 +31,7 @@ void bsp_dma_channel_irq_add(uint8_t irq_num, uint dma_channel, channel_irq_call
 {
     if (NULL == callback)
     {
-        printf("callback is NULL!\r\n");
+        DLOG_ERROR("dma irq: NULL callback for channel %u", dma_channel);
         return;
     }
 
@@ -1,5 +1,6 @@
 #include "bsp_ft6146.h"
 #include "bsp_i2c.h"
+#include "dlog.h"
 
 static bsp_touch_interface_t *g_touch_if;
 static bsp_touch_info_t *g_touch_info;
@@ -142,7 +143,7 @@ static void bsp_ft6146_init(void)
 #endif
 
     bsp_ft6146_reg_read_byte(FT6146_REG_CHIP_ID, &id, 1);
-    printf("id: 0x%02x\r\n", id);
+    DLOG_INFO("ft6146: chip id 0x%02x", id);
 }
 
 static void bsp_ft6146_get_rotation(uint16_t *rotation)
@@ -0,0 +1,82 @@
+/**
+ * dlog.c — deferred binary log: per-core rings and the drain
+ *
+ * Each ring has one producer (its core; interrupts are masked while a
+ * record is pushed) and one consumer (dlog_drain() on core 0).  A
+ * record is published with a single head update, so the drain only
+ * ever sees whole records.
+ */
+
+#include "dlog.h"
+
+#if ENABLE_DLOG
+
+#include "pico.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "spsc_ring.h"
+
+SPSC_RING_DEFINE(static, ring0, uint32_t, DLOG_RING_WORDS);
+SPSC_RING_DEFINE(static, ring1, uint32_t, DLOG_RING_WORDS);
+
+/* In RAM: called from interrupt handlers that must not touch flash */
+void __not_in_flash_func(dlog_write)(uint32_t header, const uint32_t *args)
+{
+    uint32_t core = get_core_num();
+    spsc_ring_t *r = core ? &ring1 : &ring0;
+    uint32_t n = 2 + (header & 0xF);
+    uint32_t rec[2 + DLOG_MAX_ARGS];
+
+    rec[0] = header | (core << 7);
+    for (uint32_t i = 2; i < n; i++)
+        rec[i] = args[i - 2];
+
+    uint32_t irq = save_and_disable_interrupts();
+    void *span;
+    uint32_t room;
+    spsc_ring_write_span(r, &span, &room);
+    if (room >= n) {
+        rec[1] = time_us_32();          /* in ring order */
+        spsc_ring_push(r, rec, n);
+    } else {
+        r->overflow++;                  /* whole records */
+    }
+    restore_interrupts(irq);
+}
+
+static uint32_t drain_ring(spsc_ring_t *r,
+                           void (*sink)(const void *data, uint32_t len))
+{
+    void *span;
+    uint32_t left, sent = 0;
+
+    spsc_ring_read_span(r, &span, &left);
+    while (left != 0) {
+        uint32_t run = spsc_ring_read_span(r, &span, NULL);
+        if (run > left) run = left;
+        sink(span, run * sizeof(uint32_t));
+        spsc_ring_consume(r, run);
+        left -= run;
+        sent += run * sizeof(uint32_t);
+    }
+    return sent;
+}
+
+uint32_t dlog_drain(void (*sink)(const void *data, uint32_t len))
+{
+    static uint32_t prev_dropped;
+
+    uint32_t dropped = ring0.overflow + ring1.overflow;
+    if (spsc_ring_empty(&ring0) && spsc_ring_empty(&ring1) &&
+        dropped == prev_dropped)
+        return 0;
+    prev_dropped = dropped;
+
+    const uint32_t sync[4] = {
+        DLOG_SYNC, time_us_32(), ring0.overflow, ring1.overflow
+    };
+    sink(sync, sizeof(sync));
+    return sizeof(sync) + drain_ring(&ring0, sink) + drain_ring(&ring1, sink);
+}
+
+#endif /* ENABLE_DLOG */
@@ -0,0 +1,122 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Deferred binary log
+ *
+ * A call site stores no text: the format string goes into its own
+ * section (`dlog_fmt`), and the record holds its offset, a timestamp
+ * and the raw argument words.  tools/dlog_decode.py looks the strings
+ * up in the firmware ELF and does the formatting on the PC.  Logging
+ * costs a few dozen cycles, so it can stay on in interrupt handlers.
+ *
+ *     DLOG_WARN("can: rx ring full, id 0x%x dropped", msg->id);
+ *
+ * Arguments are integers or pointers (up to DLOG_MAX_ARGS, each stored
+ * as 32 bits).  %d %i %u %x %X %o %c %p work as in printf; %s works for
+ * strings in flash (looked up in the ELF).  No floats — log milli-units
+ * instead.
+ *
+ * Each core has its own ring, so the two cores never contend; a record
+ * is pushed with interrupts masked, so thread and interrupt code on one
+ * core can share it.  A record that does not fit is dropped and
+ * counted.  dlog_drain() (core 0) hands whole records to a sink — the
+ * SD card and/or USB CDC (see pico_dashboard.cpp).
+ *
+ * Record, in 32-bit little-endian words:
+ *
+ *   header   [31:8] offset in dlog_fmt  [7] core  [5:4] level  [3:0] nargs
+ *   time     time_us_32()
+ *   args     nargs words
+ *
+ * Every drain starts with a sync record: header 0xFFFFFFFF, time, and
+ * the records dropped so far on core 0 and core 1.
+ *
+ * Lives in the bsp library so the drivers can log too; override the
+ * defaults below with compile definitions on the `bsp` target (PUBLIC,
+ * so the application sees the same values).
+ */
+
+#define DLOG_LEVEL_ERROR    0
+#define DLOG_LEVEL_WARN     1
+#define DLOG_LEVEL_INFO     2
+#define DLOG_LEVEL_DEBUG    3
+
+#ifndef ENABLE_DLOG
+#define ENABLE_DLOG         1
+#endif
+
+#ifndef DLOG_LEVEL
+#define DLOG_LEVEL          DLOG_LEVEL_INFO     /* compiled-in threshold */
+#endif
+
+#ifndef DLOG_RING_WORDS
+#define DLOG_RING_WORDS     1024                /* per core, 2^n */
+#endif
+
+#define DLOG_MAX_ARGS       6
+#define DLOG_SYNC           0xFFFFFFFFu
+
+#if ENABLE_DLOG
+
+/* Start of the format string section (defined by the linker) */
+extern const char __start_dlog_fmt[];
+
+/* Store one record; `args` holds (header & 0xF) words */
+void dlog_write(uint32_t header, const uint32_t *args);
+
+/* Pass everything logged so far to `sink`, starting with a sync record;
+ * returns the number of bytes passed.  Core 0 only. */
+uint32_t dlog_drain(void (*sink)(const void *data, uint32_t len));
+
+/* Argument count (0..DLOG_MAX_ARGS) and each argument as a word */
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_CAT_(a, b) a##b
+#define DLOG_CAT(a, b)  DLOG_CAT_(a, b)
+#define DLOG_W0()
+#define DLOG_W1(a)                  , (uint32_t)(uintptr_t)(a)
+#define DLOG_W2(a, b)               DLOG_W1(a) DLOG_W1(b)
+#define DLOG_W3(a, b, c)            DLOG_W2(a, b) DLOG_W1(c)
+#define DLOG_W4(a, b, c, d)         DLOG_W3(a, b, c) DLOG_W1(d)
+#define DLOG_W5(a, b, c, d, e)      DLOG_W4(a, b, c, d) DLOG_W1(e)
+#define DLOG_W6(a, b, c, d, e, f)   DLOG_W5(a, b, c, d, e) DLOG_W1(f)
+
+#define DLOG_(level, fmt, ...)                                          \
+    do {                                                                \
+        if ((level) <= DLOG_LEVEL) {                                    \
+            static const char dlog_fmt_[]                               \
+                __attribute__((section("dlog_fmt"), used)) = fmt;      \
+            const uint32_t dlog_args_[] = {                             \
+                0 DLOG_CAT(DLOG_W, DLOG_NARGS(__VA_ARGS__))(__VA_ARGS__) \
+            };                                                          \
+            dlog_write(((uint32_t)(dlog_fmt_ - __start_dlog_fmt) << 8)  \
+                       | ((uint32_t)(level) << 4)                       \
+                       | DLOG_NARGS(__VA_ARGS__),                       \
+                       &dlog_args_[1]);                                 \
+        }                                                               \
+    } while (0)
+
+#else /* compiled out completely */
+
+#define DLOG_(level, fmt, ...)  do { } while (0)
+
+#endif /* ENABLE_DLOG */
+
+#define DLOG_ERROR(...)     DLOG_(DLOG_LEVEL_ERROR, __VA_ARGS__)
+#define DLOG_WARN(...)      DLOG_(DLOG_LEVEL_WARN,  __VA_ARGS__)
+#define DLOG_INFO(...)      DLOG_(DLOG_LEVEL_INFO,  __VA_ARGS__)
+#define DLOG_DEBUG(...)     DLOG_(DLOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DLOG_H */
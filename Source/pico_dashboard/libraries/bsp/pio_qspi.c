@@ -2,19 +2,32 @@
  * pio_qspi.c — PIO-based QSPI driver for CO5300 OLED display
  *
  * The CO5300 accepts commands in 1-bit SPI mode (prefix 0x02) and bulk
- * pixel data in 4-bit QSPI mode (prefix 0x32).  This driver implements
- * both paths using a single PIO2 state machine:
+ * pixel data in 4-bit QSPI mode (prefix 0x32).  Both go through a
+ * single PIO2 state machine that always shifts 4 bits per clock:
  *
- *   1-bit path: each source byte is expanded to 4 FIFO bytes (one
- *               data bit on D0, other lanes idle).  Used for register
- *               writes — always blocking.
+ *   1-bit data: each source byte is expanded to one FIFO word (one
+ *               data bit on D0 per clock, other lanes idle).
  *
- *   4-bit path: each source byte maps 1:1 to one FIFO byte (4 bits
- *               per clock on D0-D3).  Pixel flushes use DMA with an
- *               ISR callback to signal completion.
+ *   4-bit data: every 4 source bytes make one FIFO word (4 bits per
+ *               clock on D0-D3).
  *
- * The PIO program shifts out 8 bits per FIFO entry with auto-pull,
- * TX FIFO joined (8-deep) for maximum throughput.
+ * Both can share one transaction — RAMWR is a 1-bit prefix followed by
+ * 4-bit pixels under the same CS.  The state machine reads the nibble
+ * count from a header word, drops CS, shifts the data and raises CS.
+ *
+ * The PIO program shifts out 32 bits per FIFO entry, MSB first, with
+ * auto-pull; TX FIFO joined (8-deep).  Bytes must leave in memory order,
+ * so the data DMA channel byte-swaps each word on the way (a
+ * little-endian load puts the first byte at the bottom).  LVGL renders
+ * with LV_COLOR_16_SWAP, so memory order is already the panel's
+ * big-endian RGB565.
+ *
+ * DMA lists use two channels: the control channel copies one
+ * { count, read_addr } block into the data channel's alias-3 registers,
+ * the write to READ_ADDR_TRIG starts the data channel, and the data
+ * channel chains back to the control channel when it is done.  The
+ * terminating { 0, NULL } block is a null trigger, which raises the data
+ * channel's interrupt (IRQ_QUIET mode: no interrupt per block).
  */
 
 #include "hardware/clocks.h"
@@ -29,165 +42,189 @@
 /* ---- State ---- */
 
 static uint pio_qspi_sm;
-static int  pio_qspi_dma_chan;
+static int  pio_qspi_dma_chan;          /* data: words → TX FIFO */
+static int  pio_qspi_ctrl_chan;         /* control blocks → data channel */
+
+/* 1-bit expansion of every byte, pre-swapped for the data channel */
+static uint32_t expand_lut[256];
 
 /* ---- Internal helpers ---- */
 
 /**
  * Configure and start the PIO state machine for QSPI output.
  *
- * SCLK is driven via side-set; D0-D3 are mapped as OUT pins.
- * TX FIFO is joined (8-entry depth) with 8-bit auto-pull, MSB first.
+ * SCLK is driven via side-set, CS via SET, D0-D3 are mapped as OUT pins.
+ * TX FIFO is joined (8-entry depth) with 32-bit auto-pull, MSB first.
  */
 static inline void qspi_program_init(PIO pio, uint sm, uint offset,
-                                      uint sclk_pin, uint d0_pin, float div)
+                                      uint sclk_pin, uint d0_pin,
+                                      uint cs_pin, uint div)
 {
     pio_sm_config c = qspi_program_get_default_config(offset);
 
     sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
     sm_config_set_sideset_pins(&c, sclk_pin);
-    sm_config_set_clkdiv(&c, div);
+    sm_config_set_set_pins(&c, cs_pin, 1);
+    sm_config_set_clkdiv_int_frac(&c, div, 0);
 
     /* Connect GPIO pads to PIO */
     pio_gpio_init(pio, sclk_pin);
+    pio_gpio_init(pio, cs_pin);
     for (uint i = 0; i < 4; i++)
         pio_gpio_init(pio, d0_pin + i);
 
     /* Internal pull-ups keep lines defined when idle */
     gpio_pull_up(sclk_pin);
+    gpio_pull_up(cs_pin);
     for (uint i = 0; i < 4; i++)
         gpio_pull_up(d0_pin + i);
 
-    /* Pin directions: SCLK + D0-D3 all outputs */
+    /* CS deasserted, SCLK low before the pins become outputs */
+    pio_sm_set_pins_with_mask(pio, sm, 1u << cs_pin,
+                              (1u << cs_pin) | (1u << sclk_pin));
+
+    /* Pin directions: SCLK + CS + D0-D3 all outputs */
     pio_sm_set_consecutive_pindirs(pio, sm, sclk_pin, 1, true);
+    pio_sm_set_consecutive_pindirs(pio, sm, cs_pin,   1, true);
     pio_sm_set_consecutive_pindirs(pio, sm, d0_pin,   4, true);
 
     sm_config_set_out_pins(&c, d0_pin, 4);
-    sm_config_set_out_shift(&c, false, true, 8);  /* MSB first, auto-pull, 8-bit */
+    sm_config_set_out_shift(&c, false, true, 32); /* MSB first, auto-pull, 32-bit */
 
     pio_sm_init(pio, sm, offset, &c);
     pio_sm_set_enabled(pio, sm, true);
 }
 
-/** Claim a DMA channel and configure it for PIO TX FIFO writes (8-bit). */
+/**
+ * Claim the DMA channel pair.  Data: 32-bit, byte-swapped, paced by the
+ * PIO TX FIFO, quiet, chaining to control.  Control: writes each
+ * 2-word block into the data channel's TRANS_COUNT / READ_ADDR_TRIG.
+ */
 static void pio_qspi_dma_init(void)
 {
-    pio_qspi_dma_chan = dma_claim_unused_channel(true);
+    pio_qspi_dma_chan  = dma_claim_unused_channel(true);
+    pio_qspi_ctrl_chan = dma_claim_unused_channel(true);
 
     dma_channel_config cfg = dma_channel_get_default_config(pio_qspi_dma_chan);
-    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_8);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_bswap(&cfg, true);
     channel_config_set_read_increment(&cfg, true);
     channel_config_set_write_increment(&cfg, false);
     channel_config_set_dreq(&cfg, pio_get_dreq(QSPI_PIO, pio_qspi_sm, true));
+    channel_config_set_chain_to(&cfg, pio_qspi_ctrl_chan);
+    channel_config_set_irq_quiet(&cfg, true);
 
     dma_channel_configure(
         pio_qspi_dma_chan, &cfg,
         &QSPI_PIO->txf[pio_qspi_sm],   /* write address: PIO TX FIFO */
-        NULL,                            /* read address: set per transfer */
-        0,                               /* count: set per transfer */
+        NULL,                            /* read address: set per block */
+        0,                               /* count: set per block */
         false);                          /* don't start yet */
+
+    cfg = dma_channel_get_default_config(pio_qspi_ctrl_chan);
+    channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&cfg, true);
+    channel_config_set_write_increment(&cfg, true);
+    channel_config_set_ring(&cfg, true, 3);     /* wrap the 8-byte write */
+
+    dma_channel_configure(
+        pio_qspi_ctrl_chan, &cfg,
+        &dma_hw->ch[pio_qspi_dma_chan].al3_transfer_count,
+        NULL,                            /* the list: set per start */
+        2,                               /* one block per trigger */
+        false);
 }
 
 /* ---- 1-bit SPI expansion ----
  *
- * The PIO program always outputs 4 data bits per clock cycle (QSPI mode).
- * To send 1-bit SPI, each source byte is exploded into 4 FIFO bytes:
- * bits [1:0] → byte 0, bits [3:2] → byte 1, etc., with each source bit
- * placed on D0 and the other three lanes held low.
+ * Each source byte becomes one FIFO word of 8 nibbles, bit 7 in the top
+ * nibble (shifted out first), each source bit placed on D0 and the other
+ * three lanes held low.
  */
 
-/** Expand a single source byte into 4 FIFO-ready bytes in `out[0..3]`. */
-static inline void expand_byte_1bit(uint8_t src, uint8_t out[4])
+/** Expand a single source byte into one FIFO-ready word. */
+static inline uint32_t expand_byte_1bit(uint8_t src)
 {
-    for (int i = 0; i < 4; i++) {
-        uint8_t bit_lo = (src >> (2 * i))     & 1;
-        uint8_t bit_hi = (src >> (2 * i + 1)) & 1;
-        out[3 - i] = bit_lo | (bit_hi << 4);
-    }
+    uint32_t w = 0;
+    for (int i = 7; i >= 0; i--)
+        w = (w << 4) | ((src >> i) & 1);
+    return w;
+}
+
+/** Blocking write of one word to the TX FIFO. */
+static inline void put_word(uint32_t w)
+{
+    while (pio_sm_is_tx_fifo_full(QSPI_PIO, pio_qspi_sm))
+        tight_loop_contents();
+    QSPI_PIO->txf[pio_qspi_sm] = w;
 }
 
 /* ---- Public API ---- */
 
-void pio_qspi_init(uint sclk_pin, uint d0_pin, uint32_t baudrate,
-                    channel_irq_callback_t irq_cb)
+uint32_t pio_qspi_init(uint sclk_pin, uint d0_pin, uint cs_pin,
+                       uint32_t baudrate, channel_irq_callback_t irq_cb)
 {
-    float div = (float)clock_get_hz(clk_sys) / (float)baudrate / 2.0f;
-    if (div < 1.0f)
-        div = 1.0f;
+    /* 3 PIO cycles per SCLK; round the divider up so SCLK <= baudrate */
+    uint32_t sys_hz = clock_get_hz(clk_sys);
+    uint div = (sys_hz + 3 * baudrate - 1) / (3 * baudrate);
+    if (div < 1)
+        div = 1;
+
+    for (uint i = 0; i < 256; i++)
+        expand_lut[i] = __builtin_bswap32(expand_byte_1bit((uint8_t)i));
 
     pio_qspi_sm = pio_claim_unused_sm(QSPI_PIO, true);
     uint offset = pio_add_program(QSPI_PIO, &qspi_program);
-    qspi_program_init(QSPI_PIO, pio_qspi_sm, offset, sclk_pin, d0_pin, div);
+    qspi_program_init(QSPI_PIO, pio_qspi_sm, offset, sclk_pin, d0_pin,
+                      cs_pin, div);
 
     pio_qspi_dma_init();
 
     if (irq_cb != NULL)
         bsp_dma_channel_irq_add(1, pio_qspi_dma_chan, irq_cb);
-}
 
-void pio_qspi_wait_idle(void)
-{
-    while (!pio_sm_is_tx_fifo_empty(QSPI_PIO, pio_qspi_sm))
-        tight_loop_contents();
-    /* After FIFO empties the shift register may still hold the last byte.
-     * At div ~1.6 that's ~4 PIO cycles ≈ 27 ns.  8 NOPs at 240 MHz ≈ 33 ns. */
-    __asm__ volatile("nop\nnop\nnop\nnop\nnop\nnop\nnop\nnop");
+    return sys_hz / (3 * div);
 }
 
-void pio_qspi_1bit_write_blocking(uint8_t byte)
+uint32_t pio_qspi_expand_1bit(uint8_t byte)
 {
-    uint8_t expanded[4];
-    expand_byte_1bit(byte, expanded);
-
-    for (int i = 0; i < 4; i++) {
-        while (pio_sm_is_tx_fifo_full(QSPI_PIO, pio_qspi_sm))
-            tight_loop_contents();
-        *(volatile uint8_t *)&QSPI_PIO->txf[pio_qspi_sm] = expanded[i];
-    }
+    return expand_lut[byte];
 }
 
-void pio_qspi_1bit_write_data_blocking(uint8_t *buf, size_t len)
+void pio_qspi_start_list(const pio_qspi_block_t *list)
 {
-    uint8_t expanded[4 * len];   /* VLA — OK for short command sequences */
-
-    for (size_t j = 0; j < len; j++)
-        expand_byte_1bit(buf[j], &expanded[j * 4]);
-
-    for (size_t i = 0; i < 4 * len; i++) {
-        while (pio_sm_is_tx_fifo_full(QSPI_PIO, pio_qspi_sm))
-            tight_loop_contents();
-        *(volatile uint8_t *)&QSPI_PIO->txf[pio_qspi_sm] = expanded[i];
-    }
+    /* Drain the M33 store buffer so DMA sees the latest SRAM contents */
+    __asm volatile("dsb sy" ::: "memory");
 
-    pio_qspi_wait_idle();
+    dma_channel_set_read_addr(pio_qspi_ctrl_chan, list, true);
 }
 
-void pio_qspi_4bit_write_data_blocking(uint8_t *buf, size_t len)
+void pio_qspi_wait_idle(void)
 {
-    for (size_t i = 0; i < len; i++) {
-        while (pio_sm_is_tx_fifo_full(QSPI_PIO, pio_qspi_sm))
-            tight_loop_contents();
-        *(volatile uint8_t *)&QSPI_PIO->txf[pio_qspi_sm] = buf[i];
-    }
-    pio_qspi_wait_idle();
+    /* TXSTALL is set while the SM waits on an empty FIFO for the next
+     * header, i.e. once the last transaction is out and CS is high.
+     * Clear it and wait for it to come back, so a stall before the
+     * last write does not count. */
+    uint32_t stall = 1u << (PIO_FDEBUG_TXSTALL_LSB + pio_qspi_sm);
+    QSPI_PIO->fdebug = stall;
+    while (!(QSPI_PIO->fdebug & stall))
+        tight_loop_contents();
 }
 
-void pio_qspi_1bit_write_data(uint8_t *buf, size_t len)
+void pio_qspi_1bit_write_data_blocking(uint8_t *buf, size_t len)
 {
-    uint8_t expanded[4 * len];   /* VLA on stack — keep len small */
-
-    for (size_t j = 0; j < len; j++)
-        expand_byte_1bit(buf[j], &expanded[j * 4]);
+    put_word(len * 8 - 1);
+    for (size_t i = 0; i < len; i++)
+        put_word(expand_byte_1bit(buf[i]));
 
-    dma_channel_set_read_addr(pio_qspi_dma_chan, expanded, false);
-    dma_channel_set_trans_count(pio_qspi_dma_chan, 4 * len, true);
+    pio_qspi_wait_idle();
 }
 
-void pio_qspi_4bit_write_data(uint8_t *buf, size_t len)
+void pio_qspi_4bit_write_data_blocking(uint8_t *buf, size_t len)
 {
-    /* Drain the M33 store buffer so DMA sees the latest SRAM contents */
-    __asm volatile("dsb sy" ::: "memory");
-
-    dma_channel_set_read_addr(pio_qspi_dma_chan, buf, false);
-    dma_channel_set_trans_count(pio_qspi_dma_chan, len, true);
+    put_word((len / 4) * 8 - 1);
+    for (size_t i = 0; i + 4 <= len; i += 4)
+        put_word((uint32_t)buf[i] << 24 | (uint32_t)buf[i + 1] << 16 |
+                 (uint32_t)buf[i + 2] << 8 | buf[i + 3]);
+    pio_qspi_wait_idle();
 }
@@ -1,10 +1,21 @@
 /**
  * pio_qspi.h — PIO-based QSPI driver for CO5300 display
  *
- * Uses PIO2 to bit-bang SPI/QSPI at up to 75 MHz.
- * Two transfer modes:
- *   1-bit (SPI):  commands and register writes — blocking.
- *   4-bit (QSPI): pixel data — DMA with ISR completion callback.
+ * Uses PIO2 to bit-bang SPI/QSPI at sys_clk / (3 × integer divider),
+ * 80 MHz at the 240 MHz system clock.  The state machine drives CS
+ * itself: every transaction is a header word followed by its data words,
+ * and CS is low exactly for the data.  Two ways to feed it:
+ *
+ *   Blocking:  the CPU writes one transaction — init sequence and
+ *              occasional register writes.
+ *   DMA list:  a chain of control blocks, each pointing the data channel
+ *              at a run of words (headers, pre-expanded commands, pixel
+ *              buffers).  Runs without the CPU; one interrupt at the end.
+ *
+ * Words go out MSB nibble first.  The data channel byte-swaps every
+ * word, so byte buffers (pixels) leave in memory order; words built for
+ * a DMA list must come from pio_qspi_header() / pio_qspi_expand_1bit(),
+ * which pre-swap them.
  */
 
 #ifndef PIO_QSPI_H
@@ -15,34 +26,50 @@
 
 #define QSPI_PIO    pio2
 
+/** One DMA control block: `count` words from `read_addr`.  A list ends
+ *  with { 0, NULL }. */
+typedef struct {
+    uint32_t    count;
+    const void *read_addr;
+} pio_qspi_block_t;
+
 /**
- * Initialise PIO state machine, DMA channel, and optional completion IRQ.
+ * Initialise PIO state machine, DMA channels, and optional completion IRQ.
  *
  * @param sclk_pin  GPIO number for the SCLK output.
  * @param d0_pin    GPIO number for data line D0 (D1-D3 follow consecutively).
- * @param baudrate  Target bit clock in Hz (PIO divider is derived from it).
- * @param irq_cb    DMA-complete callback (may be NULL if not needed).
+ * @param cs_pin    GPIO number for chip select (driven by the PIO).
+ * @param baudrate  Maximum bit clock in Hz.  The PIO divider is the
+ *                  smallest whole number that does not exceed it.
+ * @param irq_cb    End-of-list callback (may be NULL if not needed).
+ * @return          The bit clock actually set, in Hz.
  */
-void pio_qspi_init(uint sclk_pin, uint d0_pin, uint32_t baudrate,
-                    channel_irq_callback_t irq_cb);
+uint32_t pio_qspi_init(uint sclk_pin, uint d0_pin, uint cs_pin,
+                       uint32_t baudrate, channel_irq_callback_t irq_cb);
 
-/** Expand a single byte to 1-bit-over-4-lanes format and send (blocking). */
-void pio_qspi_1bit_write_blocking(uint8_t byte);
+/** Header word for a DMA list: a transaction of `words` data words. */
+static inline uint32_t pio_qspi_header(uint32_t words)
+{
+    return __builtin_bswap32(words * 8 - 1);
+}
 
-/** Send an array of bytes in 1-bit SPI mode (blocking, waits for idle). */
-void pio_qspi_1bit_write_data_blocking(uint8_t *buf, size_t len);
+/** One byte in 1-bit SPI mode (bit on D0) as a data word for a DMA list. */
+uint32_t pio_qspi_expand_1bit(uint8_t byte);
 
-/** Send an array of bytes in native 4-bit QSPI mode (blocking). */
-void pio_qspi_4bit_write_data_blocking(uint8_t *buf, size_t len);
+/** Start a DMA list (non-blocking).  The list and everything it points
+ *  to must stay untouched until the end-of-list callback. */
+void pio_qspi_start_list(const pio_qspi_block_t *list);
 
-/** Send bytes in 1-bit mode via DMA (non-blocking — uses VLA on stack). */
-void pio_qspi_1bit_write_data(uint8_t *buf, size_t len);
+/** Send bytes as one 1-bit SPI transaction (blocking, waits for idle).
+ *  Not while a DMA list is running. */
+void pio_qspi_1bit_write_data_blocking(uint8_t *buf, size_t len);
 
-/** Send bytes in 4-bit QSPI mode via DMA (non-blocking). */
-void pio_qspi_4bit_write_data(uint8_t *buf, size_t len);
+/** Send bytes as one 4-bit QSPI transaction (blocking, waits for idle).
+ *  len must be a multiple of 4.  Not while a DMA list is running. */
+void pio_qspi_4bit_write_data_blocking(uint8_t *buf, size_t len);
 
-/** Busy-wait until the PIO TX FIFO is fully drained and the last byte
- *  has been shifted out on the bus. */
+/** Busy-wait until every queued transaction has been shifted out and
+ *  CS is high again. */
 void pio_qspi_wait_idle(void);
 
 #endif /* PIO_QSPI_H */
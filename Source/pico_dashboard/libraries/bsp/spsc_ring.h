@@ -0,0 +1,220 @@
+#ifndef __SPSC_RING_H__
+#define __SPSC_RING_H__
+
+/*
+ * spsc_ring.h — lock-free single-producer / single-consumer ring
+ *
+ * One writer and one reader, each on its own core or one of them in an
+ * interrupt handler.  Capacity is a power of two, so indices are masked
+ * rather than reduced with `%`.  `head` and `tail` run freely and wrap
+ * at 2^32; the fill level is always head - tail.
+ *
+ * Ordering: the producer writes the elements, then publishes `head`
+ * with release semantics; the consumer reads `head` with acquire
+ * semantics before touching the elements, and hands slots back the
+ * same way through `tail`.  On the M33 this compiles to a DMB around
+ * the index access, which is what makes it safe across the two cores.
+ *
+ * Bulk access works on contiguous spans: spsc_ring_write_span() /
+ * spsc_ring_read_span() return a pointer and the number of elements
+ * available before the wrap point; commit what was used with
+ * spsc_ring_produce() / spsc_ring_consume().
+ *
+ * Counters (producer-owned): `high_water` is the highest fill level
+ * ever seen, `overflow` the number of elements rejected for lack of
+ * space.
+ *
+ * C:   SPSC_RING_DEFINE(static, rx, bsp_can_frame_t, 32);
+ *      spsc_ring_push(&rx, &frame, 1);
+ * C++: spsc_ring<bsp_can_frame_t, 32> rx;   rx.push(frame);
+ *
+ * Header-only; elements are copied with memcpy (trivially copyable).
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t  *buf;
+    uint32_t  elem_size;
+    uint32_t  mask;             /* capacity - 1 */
+    uint32_t  head;             /* written by the producer only */
+    uint32_t  tail;             /* written by the consumer only */
+    uint32_t  high_water;
+    uint32_t  overflow;
+} spsc_ring_t;
+
+#define SPSC_RING_IS_POW2(n)    ((n) != 0 && ((n) & ((n) - 1)) == 0)
+
+/* Define `name` (a spsc_ring_t) with static storage for `cap` elements
+ * of `type`; `qual` is e.g. `static` or empty. */
+#define SPSC_RING_DEFINE(qual, name, type, cap)                           \
+    _Static_assert(SPSC_RING_IS_POW2(cap), #name ": capacity not 2^n");  \
+    static type name##_storage[cap];                                      \
+    qual spsc_ring_t name = {                                             \
+        (uint8_t *)name##_storage, sizeof(type), (cap) - 1, 0, 0, 0, 0    \
+    }
+
+static inline void spsc_ring_init(spsc_ring_t *r, void *storage,
+                                  uint32_t elem_size, uint32_t capacity)
+{
+    r->buf        = (uint8_t *)storage;
+    r->elem_size  = elem_size;
+    r->mask       = capacity - 1;
+    r->head       = 0;
+    r->tail       = 0;
+    r->high_water = 0;
+    r->overflow   = 0;
+}
+
+static inline uint32_t spsc_ring_capacity(const spsc_ring_t *r)
+{
+    return r->mask + 1;
+}
+
+/* ---- Producer side ---- */
+
+/* Free space, and the contiguous part of it starting at *span */
+static inline uint32_t spsc_ring_write_span(spsc_ring_t *r, void **span,
+                                           uint32_t *free_total)
+{
+    uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    uint32_t head = r->head;
+    uint32_t room = r->mask + 1 - (head - tail);
+    uint32_t idx  = head & r->mask;
+    uint32_t run  = r->mask + 1 - idx;
+
+    *span = r->buf + idx * r->elem_size;
+    if (free_total != NULL) *free_total = room;
+    return room < run ? room : run;
+}
+
+/* Publish `n` elements written into the span(s) */
+static inline void spsc_ring_produce(spsc_ring_t *r, uint32_t n)
+{
+    uint32_t head = r->head + n;
+    uint32_t used = head - __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    if (used > r->high_water) r->high_water = used;
+    __atomic_store_n(&r->head, head, __ATOMIC_RELEASE);
+}
+
+/* Copy in up to `n` elements; the rest count as overflow.  Returns the
+ * number stored. */
+static inline uint32_t spsc_ring_push(spsc_ring_t *r, const void *src,
+                                      uint32_t n)
+{
+    const uint8_t *s = (const uint8_t *)src;
+    void    *span;
+    uint32_t room;
+    uint32_t run = spsc_ring_write_span(r, &span, &room);
+    uint32_t put = n < room ? n : room;
+
+    uint32_t first = put < run ? put : run;
+    memcpy(span, s, first * r->elem_size);
+    memcpy(r->buf, s + first * r->elem_size, (put - first) * r->elem_size);
+
+    r->overflow += n - put;
+    spsc_ring_produce(r, put);
+    return put;
+}
+
+/* ---- Consumer side ---- */
+
+/* Fill level, and the contiguous part of it starting at *span */
+static inline uint32_t spsc_ring_read_span(spsc_ring_t *r, void **span,
+                                          uint32_t *used_total)
+{
+    uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = r->tail;
+    uint32_t used = head - tail;
+    uint32_t idx  = tail & r->mask;
+    uint32_t run  = r->mask + 1 - idx;
+
+    *span = r->buf + idx * r->elem_size;
+    if (used_total != NULL) *used_total = used;
+    return used < run ? used : run;
+}
+
+/* Hand `n` read elements back to the producer */
+static inline void spsc_ring_consume(spsc_ring_t *r, uint32_t n)
+{
+    __atomic_store_n(&r->tail, r->tail + n, __ATOMIC_RELEASE);
+}
+
+/* Copy out up to `n` elements; returns the number read */
+static inline uint32_t spsc_ring_pop(spsc_ring_t *r, void *dst, uint32_t n)
+{
+    uint8_t *d = (uint8_t *)dst;
+    void    *span;
+    uint32_t used;
+    uint32_t run = spsc_ring_read_span(r, &span, &used);
+    uint32_t got = n < used ? n : used;
+
+    uint32_t first = got < run ? got : run;
+    memcpy(d, span, first * r->elem_size);
+    memcpy(d + first * r->elem_size, r->buf, (got - first) * r->elem_size);
+
+    spsc_ring_consume(r, got);
+    return got;
+}
+
+static inline bool spsc_ring_empty(const spsc_ring_t *r)
+{
+    return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == r->tail;
+}
+
+#ifdef __cplusplus
+}
+
+/* Typed wrapper with compile-time capacity and its own storage */
+template <typename T, uint32_t N>
+class spsc_ring {
+    static_assert(SPSC_RING_IS_POW2(N), "spsc_ring capacity must be 2^n");
+
+public:
+    spsc_ring() { spsc_ring_init(&r_, buf_, sizeof(T), N); }
+    spsc_ring(const spsc_ring &) = delete;
+    spsc_ring &operator=(const spsc_ring &) = delete;
+
+    bool     push(const T &v)             { return spsc_ring_push(&r_, &v, 1) == 1; }
+    bool     pop(T &v)                    { return spsc_ring_pop(&r_, &v, 1) == 1; }
+    uint32_t push(const T *v, uint32_t n) { return spsc_ring_push(&r_, v, n); }
+    uint32_t pop(T *v, uint32_t n)        { return spsc_ring_pop(&r_, v, n); }
+
+    uint32_t write_span(T **span, uint32_t *free_total = nullptr)
+    {
+        void *p;
+        uint32_t n = spsc_ring_write_span(&r_, &p, free_total);
+        *span = static_cast<T *>(p);
+        return n;
+    }
+    void     produce(uint32_t n)          { spsc_ring_produce(&r_, n); }
+
+    uint32_t read_span(const T **span, uint32_t *used_total = nullptr)
+    {
+        void *p;
+        uint32_t n = spsc_ring_read_span(&r_, &p, used_total);
+        *span = static_cast<const T *>(p);
+        return n;
+    }
+    void     consume(uint32_t n)          { spsc_ring_consume(&r_, n); }
+
+    bool     empty() const                { return spsc_ring_empty(&r_); }
+    uint32_t high_water() const           { return r_.high_water; }
+    uint32_t overflow() const             { return r_.overflow; }
+
+    spsc_ring_t *c_ring()                 { return &r_; }
+
+private:
+    T           buf_[N];
+    spsc_ring_t r_;
+};
+
+#endif /* __cplusplus */
+
+#endif /* __SPSC_RING_H__ */
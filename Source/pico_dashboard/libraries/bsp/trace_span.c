@@ -0,0 +1,128 @@
+/**
+ * trace_span.c — per-core span flight recorder and Chrome trace export
+ *
+ * Each core writes only its own ring, with interrupts masked for the
+ * few cycles a slot takes.  The export pauses recording first, so it
+ * reads rings nobody is writing.
+ */
+
+#include "trace_span.h"
+
+#if ENABLE_TRACE_SPAN
+
+#include <stdio.h>
+#include "pico.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+_Static_assert((TRACE_SPAN_EVENTS & (TRACE_SPAN_EVENTS - 1)) == 0,
+               "TRACE_SPAN_EVENTS must be a power of two");
+
+typedef struct {
+    uint32_t    t_us;
+    const char *name;
+    uint8_t     begin;
+    uint8_t     track;
+} span_event_t;
+
+typedef struct {
+    span_event_t ev[TRACE_SPAN_EVENTS];
+    uint32_t     head;                      /* events ever recorded */
+} recorder_t;
+
+static recorder_t    rec[2];
+static volatile bool paused;
+
+/* In RAM: called from interrupt handlers that must not touch flash */
+void __not_in_flash_func(trace_span_record)(const char *name, bool begin,
+                                            uint8_t track)
+{
+    if (paused)
+        return;
+
+    uint32_t core = get_core_num();
+    recorder_t *r = &rec[core];
+
+    uint32_t irq = save_and_disable_interrupts();
+    span_event_t *e = &r->ev[r->head & (TRACE_SPAN_EVENTS - 1)];
+    e->t_us  = time_us_32();
+    e->name  = name;
+    e->begin = begin;
+    e->track = track == TRACE_TRACK_CORE ? (uint8_t)core : track;
+    r->head++;
+    restore_interrupts(irq);
+}
+
+/* ---- Export ---- */
+
+static uint32_t oldest(const recorder_t *r)
+{
+    uint32_t n = r->head < TRACE_SPAN_EVENTS ? r->head : TRACE_SPAN_EVENTS;
+    return r->head - n;
+}
+
+uint32_t trace_span_export_json(void (*sink)(const char *data, uint32_t len))
+{
+    static const char *const track_names[TRACE_TRACK_COUNT] = {
+        "core 0", "core 1", "flush DMA"
+    };
+    char line[128];
+    int  len;
+    uint32_t written = 0;
+
+    paused = true;
+    busy_wait_us_32(10);        /* let a record in progress on core 1 finish */
+
+    /* Timestamps relative to the oldest event still held */
+    bool     have_t0 = false;
+    uint32_t t0 = 0;
+    for (int c = 0; c < 2; c++) {
+        if (rec[c].head == 0) continue;
+        uint32_t t = rec[c].ev[oldest(&rec[c]) & (TRACE_SPAN_EVENTS - 1)].t_us;
+        if (!have_t0 || (int32_t)(t - t0) < 0) t0 = t;
+        have_t0 = true;
+    }
+
+    len = snprintf(line, sizeof(line),
+                   "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    sink(line, (uint32_t)len);
+    for (int t = 0; t < TRACE_TRACK_COUNT; t++) {
+        len = snprintf(line, sizeof(line),
+                       "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                       "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                       t ? "," : "", t, track_names[t]);
+        sink(line, (uint32_t)len);
+    }
+
+    for (int c = 0; c < 2; c++) {
+        const recorder_t *r = &rec[c];
+        uint32_t depth[TRACE_TRACK_COUNT] = {0};
+
+        for (uint32_t i = oldest(r); i != r->head; i++) {
+            const span_event_t *e = &r->ev[i & (TRACE_SPAN_EVENTS - 1)];
+            if (e->track >= TRACE_TRACK_COUNT)
+                continue;
+            /* An end whose begin was overwritten would confuse viewers */
+            if (!e->begin) {
+                if (depth[e->track] == 0) continue;
+                depth[e->track]--;
+            } else {
+                depth[e->track]++;
+            }
+            len = snprintf(line, sizeof(line),
+                           ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lu,"
+                           "\"pid\":1,\"tid\":%u}",
+                           e->name, e->begin ? 'B' : 'E',
+                           (unsigned long)(e->t_us - t0), (unsigned)e->track);
+            if (len >= (int)sizeof(line)) continue;     /* absurd name */
+            sink(line, (uint32_t)len);
+            written++;
+        }
+    }
+
+    sink("\n]}\n", 4);
+    paused = false;
+    return written;
+}
+
+#endif /* ENABLE_TRACE_SPAN */
@@ -0,0 +1,83 @@
+#ifndef TRACE_SPAN_H
+#define TRACE_SPAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Timeline spans for both cores (Chrome trace format)
+ *
+ *     TRACE_BEGIN("disp_flush");
+ *     ...
+ *     TRACE_END("disp_flush");
+ *
+ * Each event is a timestamp, the name (a string literal — only the
+ * pointer is stored), begin/end and a track.  Events go into a per-core
+ * flight recorder: a ring that keeps the last TRACE_SPAN_EVENTS events
+ * and overwrites the oldest, so the trace always covers the most recent
+ * fraction of a second before the dump.  Recording masks interrupts for
+ * a few cycles, so spans can be opened in interrupt handlers; a handler
+ * that interrupts a span nests inside it on the timeline.
+ *
+ * Work that is not code on a core, such as a DMA transfer, goes on its
+ * own track with TRACE_BEGIN_ON / TRACE_END_ON; begin and end may then
+ * come from different contexts of the same core (kick-off and
+ * completion IRQ).
+ *
+ * trace_span_export_json() pauses recording, streams the Chrome trace
+ * JSON to a sink and resumes; the file opens in Perfetto or
+ * chrome://tracing.  The application writes it to the SD card (see
+ * pico_dashboard.cpp).
+ *
+ * Lives in the bsp library so the drivers can record spans; override
+ * the defaults below with compile definitions on the `bsp` target.
+ */
+
+#ifndef ENABLE_TRACE_SPAN
+#define ENABLE_TRACE_SPAN   1
+#endif
+
+#ifndef TRACE_SPAN_EVENTS
+#define TRACE_SPAN_EVENTS   1024            /* per core, 2^n; 12 bytes each */
+#endif
+
+typedef enum {
+    TRACE_TRACK_CORE0,
+    TRACE_TRACK_CORE1,
+    TRACE_TRACK_DMA,                        /* display flush transfers */
+    TRACE_TRACK_COUNT
+} trace_track_t;
+
+#define TRACE_TRACK_CORE    0xFF            /* the recording core */
+
+#if ENABLE_TRACE_SPAN
+
+void trace_span_record(const char *name, bool begin, uint8_t track);
+
+/* Stream the recorded events as Chrome trace JSON; returns the number
+ * of events written.  Recording is paused meanwhile.  Core 0 only. */
+uint32_t trace_span_export_json(void (*sink)(const char *data, uint32_t len));
+
+#define TRACE_BEGIN(name)           trace_span_record(name, true,  TRACE_TRACK_CORE)
+#define TRACE_END(name)             trace_span_record(name, false, TRACE_TRACK_CORE)
+#define TRACE_BEGIN_ON(track, name) trace_span_record(name, true,  track)
+#define TRACE_END_ON(track, name)   trace_span_record(name, false, track)
+
+#else /* compiled out completely */
+
+#define TRACE_BEGIN(name)           do { } while (0)
+#define TRACE_END(name)             do { } while (0)
+#define TRACE_BEGIN_ON(track, name) do { } while (0)
+#define TRACE_END_ON(track, name)   do { } while (0)
+
+#endif /* ENABLE_TRACE_SPAN */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACE_SPAN_H */
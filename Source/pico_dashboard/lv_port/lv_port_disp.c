@@ -7,26 +7,138 @@
  *
  * A rounder callback aligns dirty areas to even pixel boundaries —
  * required by the CO5300 column/row addressing.
+ *
+ * The panel is round.  With DISP_ROUND_CLIP each flushed area is cut to
+ * the visible circle: a table built at init holds the visible columns of
+ * every row pair, and the flush merges consecutive pairs into bands
+ * (one panel window each) while the extra corner pixels cost less than
+ * a window setup.  Only the bands' pixels go out; the corners of a
+ * full-screen refresh are ~20% of it.
+ *
+ * Render start, buffer waits, refresh end and flush DMA time feed the
+ * render performance counters (diag/render_perf.h).
+ *
+ * With ENABLE_TE_SYNC the panel's TE pulse paces the refreshes.  The
+ * TE interrupt only flags a vsync; lv_port_disp_vsync(), from the
+ * super-loop, makes LVGL's refresh timer due when something is
+ * invalidated, or restarts its period when nothing is, so a later
+ * invalidation still waits for the next vsync.  The timer itself runs
+ * at DISP_TE_FALLBACK_MS and only fires if TE goes quiet.
  */
 
 #include "lv_port_disp.h"
 #include <stdbool.h>
+#include "pico/stdlib.h"
 #include "config.h"
 #include "bsp_co5300.h"
+#include "latency_trace.h"
+#include "render_perf.h"
+#include "dlog.h"
+#include "trace_span.h"
 
 /* ---- State ---- */
 
 static lv_disp_drv_t         disp_drv;
 static bsp_display_interface_t *display_if;
+static volatile bool         flushing_last;  /* DMA carries the last area */
+
+#if DISP_ROUND_CLIP
+_Static_assert(DISP_HOR_RES == DISP_VER_RES, "round clip needs a square panel");
+
+/* First visible column of each row pair, even; the last is its mirror */
+static uint16_t              round_x1[DISP_VER_RES / 2];
+static bsp_display_area_t    flush_spans[BSP_CO5300_MAX_SPANS];
+#endif
+
+#if ENABLE_TE_SYNC
+static lv_disp_t            *disp;
+static volatile bool         vsync_pending;  /* paced TE edge not yet acted on */
+static volatile bool         frame_in_flight; /* render start → last area out */
+static volatile uint32_t     te_last_us;
+static uint8_t               te_count;
+#endif
 
 /* ---- Callbacks ---- */
 
 /** DMA-complete callback — invoked from ISR context by bsp_cd5300. */
 static void disp_flush_done(void)
 {
+    render_perf_flush_done();
+    if (flushing_last) {
+        latency_flushed();
+        render_perf_frame_flushed();
+#if ENABLE_TE_SYNC
+        frame_in_flight = false;
+#endif
+    }
     lv_disp_flush_ready(&disp_drv);
 }
 
+#if ENABLE_TE_SYNC
+/** TE rising edge — invoked from ISR context by bsp_cd5300. */
+static void disp_te(void)
+{
+    te_last_us = time_us_32();
+    if (++te_count < DISP_TE_DIVIDER)
+        return;
+    te_count = 0;
+    render_perf_vsync(frame_in_flight);
+    vsync_pending = true;
+}
+#endif
+
+#if ENABLE_RENDER_PERF || ENABLE_TE_SYNC
+/** Start of a refresh (before the first area is rendered). */
+static void render_start_cb(lv_disp_drv_t *drv)
+{
+    (void)drv;
+#if ENABLE_TE_SYNC
+    frame_in_flight = true;
+#endif
+    render_perf_frame_start();
+}
+#endif
+
+#if ENABLE_RENDER_PERF
+
+/**
+ * Called by LVGL while it needs a buffer the DMA still owns.  Waits for
+ * the DMA here in one go so the blocked time can be measured.
+ */
+static void wait_cb(lv_disp_drv_t *drv)
+{
+    uint32_t t0 = time_us_32();
+    while (drv->draw_buf->flushing)
+        tight_loop_contents();
+    render_perf_wait(time_us_32() - t0);
+}
+
+/** End of a refresh: `px` invalidated pixels were rendered. */
+static void monitor_cb(lv_disp_drv_t *drv, uint32_t time, uint32_t px)
+{
+    (void)drv;
+    (void)time;             /* whole ms only; render_perf keeps µs */
+    render_perf_frame_end(px);
+}
+#endif
+
+/** Panel commands queued while nothing was flushing. */
+static void disp_poll_cb(lv_timer_t *timer)
+{
+    (void)timer;
+    display_if->poll();
+
+#if ENABLE_TE_SYNC
+    static bool te_warned;
+    if (!te_warned && time_us_32() - te_last_us > 500 * 1000) {
+        te_warned = true;
+        lv_timer_set_period(disp->refr_timer, LV_DISP_DEF_REFR_PERIOD);
+        DLOG_WARN("disp: no TE on GPIO%u, %u ms timer pacing",
+                  BSP_OLED_TE_PIN, LV_DISP_DEF_REFR_PERIOD);
+    }
+#endif
+}
+
 /**
  * Rounder: align dirty-area edges to even pixel boundaries.
  * The CO5300 column/row commands require even-aligned start addresses
@@ -41,6 +153,68 @@ static void rounder_cb(lv_disp_drv_t *drv, lv_area_t *area)
     area->y2 = ((area->y2 >> 1) << 1) + 1;
 }
 
+#if DISP_ROUND_CLIP
+/**
+ * Fill round_x1[]: a pixel is kept when its centre lies within
+ * DISP_ROUND_MARGIN of the circle.  Worked in half pixels to stay in
+ * integers; the circle is symmetric, so any rotation sees the same table.
+ */
+static void round_span_init(void)
+{
+    const int32_t n = DISP_HOR_RES;
+    const int32_t r = n + 2 * DISP_ROUND_MARGIN;     /* radius, half px */
+
+    for (int32_t y = 0; y < n; y++) {
+        int32_t dy = 2 * y + 1 - n;
+        int32_t x  = 0;
+        while (x < n / 2 &&
+               (2 * x + 1 - n) * (2 * x + 1 - n) + dy * dy > r * r)
+            x++;
+        x &= ~1;
+        if (y % 2 == 0 || x < round_x1[y / 2])
+            round_x1[y / 2] = (uint16_t)x;
+    }
+}
+
+/**
+ * Cut an area to the circle: fills flush_spans[] top to bottom and
+ * returns the count.  A row pair joins the band above it while the
+ * pixels this adds (both widened to their union) stay within
+ * DISP_ROUND_BAND_COST_PX; once the spans run out, the last band takes
+ * the rest.
+ */
+static uint16_t clip_to_circle(const lv_area_t *area)
+{
+    uint16_t n = 0;
+
+    for (int32_t p = area->y1 / 2; p <= area->y2 / 2; p++) {
+        int32_t x1 = LV_MAX(area->x1, round_x1[p]);
+        int32_t x2 = LV_MIN(area->x2, DISP_HOR_RES - 1 - round_x1[p]);
+        if (x1 > x2)
+            continue;                       /* pair misses the circle */
+
+        if (n) {
+            bsp_display_area_t *s = &flush_spans[n - 1];
+            int32_t u1 = LV_MIN(s->x1, x1);
+            int32_t u2 = LV_MAX(s->x2, x2);
+            int32_t extra = (s->x1 - u1 + u2 - s->x2) * (s->y2 - s->y1 + 1) +
+                            (x1 - u1 + u2 - x2) * 2;
+            if (n == BSP_CO5300_MAX_SPANS ||
+                (s->y2 + 1 == 2 * p && extra <= DISP_ROUND_BAND_COST_PX)) {
+                s->x1 = u1;
+                s->x2 = u2;
+                s->y2 = 2 * p + 1;
+                continue;
+            }
+        }
+        flush_spans[n++] = (bsp_display_area_t){
+            .x1 = x1, .y1 = 2 * p, .x2 = x2, .y2 = 2 * p + 1,
+        };
+    }
+    return n;
+}
+#endif
+
 /**
  * Flush callback — hands the pixel buffer to the display driver for
  * DMA transfer.  lv_disp_flush_ready() is called asynchronously from
@@ -49,12 +223,32 @@ static void rounder_cb(lv_disp_drv_t *drv, lv_area_t *area)
 static void disp_flush(lv_disp_drv_t *drv, const lv_area_t *area,
                         lv_color_t *color_p)
 {
-    (void)drv;
+    TRACE_BEGIN("disp_flush");
+    DLOG_DEBUG("disp: flush %d,%d..%d,%d", area->x1, area->y1,
+               area->x2, area->y2);
+    flushing_last = lv_disp_flush_is_last(drv);
+    if (flushing_last)
+        latency_rendered();
+
     bsp_display_area_t da = {
         .x1 = area->x1, .y1 = area->y1,
         .x2 = area->x2, .y2 = area->y2,
     };
+    uint32_t area_px = lv_area_get_size(area);
+
+#if DISP_ROUND_CLIP
+    uint16_t n = clip_to_circle(area);
+    uint32_t sent_px = 0;
+    for (uint16_t i = 0; i < n; i++)
+        sent_px += (uint32_t)(flush_spans[i].x2 - flush_spans[i].x1 + 1) *
+                   (flush_spans[i].y2 - flush_spans[i].y1 + 1);
+    render_perf_flush_start(area_px, sent_px);
+    display_if->flush_dma_spans(&da, (uint16_t *)color_p, flush_spans, n);
+#else
+    render_perf_flush_start(area_px, area_px);
     display_if->flush_dma(&da, (uint16_t *)color_p);
+#endif
+    TRACE_END("disp_flush");
 }
 
 /* ---- Public API ---- */
@@ -71,9 +265,15 @@ void lv_port_disp_init(uint16_t width, uint16_t height,
         .rotation  = rotation,
         .brightness = 80,
         .dma_flush_done_cb = disp_flush_done,
+#if ENABLE_TE_SYNC
+        .te_cb      = disp_te,
+#endif
     };
     bsp_display_new_co5300(&display_if, &info);
     display_if->init();
+#if DISP_ROUND_CLIP
+    round_span_init();
+#endif
 
     /* Allocate draw buffers */
     static lv_disp_draw_buf_t draw_buf;
@@ -98,11 +298,47 @@ void lv_port_disp_init(uint16_t width, uint16_t height,
     disp_drv.flush_cb     = disp_flush;
     disp_drv.direct_mode  = enabled_direct_mode;
     disp_drv.rounder_cb   = rounder_cb;
+#if ENABLE_RENDER_PERF || ENABLE_TE_SYNC
+    disp_drv.render_start_cb = render_start_cb;
+#endif
+#if ENABLE_RENDER_PERF
+    disp_drv.wait_cb      = wait_cb;
+    disp_drv.monitor_cb   = monitor_cb;
+#endif
 
     /* Software rotation (MADCTL does not work on CO5300) */
     disp_drv.sw_rotate = (DISP_ROTATION != LV_DISP_ROT_NONE);
     disp_drv.rotated   = DISP_ROTATION;
 
     disp_drv.draw_buf = &draw_buf;
+#if ENABLE_TE_SYNC
+    disp = lv_disp_drv_register(&disp_drv);
+    lv_timer_set_period(disp->refr_timer, DISP_TE_FALLBACK_MS);
+    te_last_us = time_us_32();      /* the no-TE warning counts from here */
+#else
     lv_disp_drv_register(&disp_drv);
+#endif
+
+    lv_timer_create(disp_poll_cb, DISP_CMD_POLL_MS, NULL);
+}
+
+#if ENABLE_TE_SYNC
+bool lv_port_disp_vsync_pending(void)
+{
+    return vsync_pending;
+}
+
+void lv_port_disp_vsync(void)
+{
+    if (!vsync_pending)
+        return;
+    vsync_pending = false;
+
+    /* The refresh timer pauses itself once nothing is invalidated and
+     * resumes on the next invalidation */
+    if (disp->refr_timer->paused)
+        lv_timer_reset(disp->refr_timer);
+    else
+        lv_timer_ready(disp->refr_timer);
 }
+#endif
@@ -10,6 +10,7 @@ extern "C" {
 #endif
 
 #include "lvgl.h"
+#include "config.h"
 
 /**
  * Initialise the display driver and register it with LVGL.
@@ -24,6 +25,25 @@ extern "C" {
 void lv_port_disp_init(uint16_t width, uint16_t height,
                         uint16_t rotation, bool enabled_direct_mode);
 
+#if ENABLE_TE_SYNC
+
+/** A paced TE edge is waiting for lv_port_disp_vsync() (any context). */
+bool lv_port_disp_vsync_pending(void);
+
+/**
+ * Act on a pending vsync: start the refresh now if something is
+ * invalidated, otherwise hold it until the next one.  Super-loop only,
+ * between lv_timer_handler() calls.
+ */
+void lv_port_disp_vsync(void);
+
+#else /* stubs — LVGL's refresh timer paces the frames */
+
+static inline bool lv_port_disp_vsync_pending(void) { return false; }
+static inline void lv_port_disp_vsync(void) {}
+
+#endif /* ENABLE_TE_SYNC */
+
 #ifdef __cplusplus
 }
 #endif
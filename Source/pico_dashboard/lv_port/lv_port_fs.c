@@ -166,7 +166,8 @@ static void * fs_open(lv_fs_drv_t * drv, const char * path, lv_fs_mode_t mode)
     LV_UNUSED(drv);
     uint8_t flags = 0;
 
-    if(mode == LV_FS_MODE_WR) flags = FA_WRITE | FA_OPEN_ALWAYS;
+    /*Write-only replaces the file ("w"); read-write keeps it ("r+")*/
+    if(mode == LV_FS_MODE_WR) flags = FA_WRITE | FA_CREATE_ALWAYS;
     else if(mode == LV_FS_MODE_RD) flags = FA_READ;
     else if(mode == (LV_FS_MODE_WR | LV_FS_MODE_RD)) flags = FA_READ | FA_WRITE | FA_OPEN_ALWAYS;
 
@@ -2,9 +2,16 @@
  * pico_dashboard — main entry point
  *
  * Core 0: LVGL rendering, display flush (PIO2 QSPI DMA), touch input.
- * Core 1: CAN bus reception + protocol parsing (PIO0, ME442 mode only).
+ * Core 1: ECU input — Invent EMS over UART0 and/or ME442 over CAN
+ *         (PIO0), selected at boot (config.h defaults, SD ecu.cfg), run
+ *         as tasks on a cooperative deadline executive (sched/exec.h).
+ *         CAN decode tables come from the SD card if present, else the
+ *         compiled-in ME442 DBC.
  *
- * ECU data flows:  core 1 → invent_ems_data_t → core 0 LVGL timer → UI.
+ * ECU data flows:  core 1 → invent_ems_publish() → triple buffer →
+ *                  invent_ems_acquire() in the core 0 LVGL timer → UI.
+ * Both cores sleep in WFE when idle; core 1 wakes core 0 with a SEV
+ * after each publish.
  * All LVGL widget updates happen inside lv_timer_handler() to respect
  * LVGL's single-threaded dirty-area tracking.
  *
@@ -12,6 +19,9 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include "pico/stdlib.h"
 #include "hardware/clocks.h"
 #include "hardware/structs/sio.h"
@@ -19,18 +29,27 @@
 #include "config.h"
 #include "lv_port_disp.h"
 #include "lv_port_indev.h"
+#include "lv_port_fs.h"
 #include "bsp_i2c.h"
 #include "ui/ui_dashboard.h"
 #include "ui/ui_debug_console.h"
+#include "dlog.h"
+#include "trace_span.h"
 
 extern "C" {
-#include "bsp_serial.h"
 #include "bsp_can.h"
 #include "protocol/invent_ems.h"
+#include "protocol/ecu_input.h"
+#include "diag/latency_trace.h"
+#include "diag/render_perf.h"
+#include "diag/mem_watch.h"
+#include "diag/profiler.h"
+#include "sched/exec.h"
 }
 
-#if ECU_PROTOCOL == ECU_ME442
 #include "pico/multicore.h"
+#if DLOG_USB
+#include "pico/stdio_usb.h"
 #endif
 
 /* ---- Clock configuration ---- */
@@ -55,73 +74,165 @@ static bool repeating_lvgl_timer_cb(struct repeating_timer *t)
 }
 
 /* ======================================================================
- * ECU_INVENT_EMS — UART path (core 0 only)
+ * Boot-time configuration from the SD card (core 0, before core 1 runs)
  * ====================================================================== */
-#if ECU_PROTOCOL == ECU_INVENT_EMS
 
-/*
- * UART0 RX interrupt ring buffer.
- * At 19200 baud packets arrive every ~22 ms, but lv_timer_handler() can
- * block for 20-50 ms during rendering.  The hardware FIFO is only 32 B
- * (~16.7 ms at 19200), so without an ISR we lose bytes and get CRC errors.
- */
-#define UART_RX_BUF_SIZE 256
-static volatile uint8_t  uart_rx_buf[UART_RX_BUF_SIZE];
-static volatile uint16_t uart_rx_head = 0;
-static uint16_t          uart_rx_tail = 0;
-
-extern "C" void uart0_irq_handler(void)
-{
-    while (uart_is_readable(uart0)) {
-        uint8_t ch = (uint8_t)uart_getc(uart0);
-        uint16_t next = (uart_rx_head + 1) % UART_RX_BUF_SIZE;
-        if (next != uart_rx_tail) {           /* drop on overflow */
-            uart_rx_buf[uart_rx_head] = ch;
-            uart_rx_head = next;
-        }
+/* Read a whole file into a malloc'd buffer; NULL if missing or too big */
+static uint8_t *read_sd_file(const char *path, uint32_t max_size,
+                             uint32_t *size_out)
+{
+    if (path[0] == '\0') return NULL;
+
+    lv_fs_file_t f;
+    if (lv_fs_open(&f, path, LV_FS_MODE_RD) != LV_FS_RES_OK)
+        return NULL;
+
+    uint32_t size = 0;
+    lv_fs_seek(&f, 0, LV_FS_SEEK_END);
+    lv_fs_tell(&f, &size);
+    lv_fs_seek(&f, 0, LV_FS_SEEK_SET);
+
+    uint8_t *blob = NULL;
+    uint32_t got = 0;
+    if (size > 0 && size <= max_size)
+        blob = (uint8_t *)malloc(size);
+    if (blob != NULL &&
+        (lv_fs_read(&f, blob, size, &got) != LV_FS_RES_OK || got != size)) {
+        free(blob);
+        blob = NULL;
     }
+    lv_fs_close(&f);
+
+    *size_out = size;
+    return blob;
 }
 
-#endif /* ECU_INVENT_EMS */
+/* Source selection and per-channel priorities (ecu_input.h) */
+static void load_ecu_config_from_sd(void)
+{
+    uint32_t size;
+    uint8_t *text = read_sd_file(ECU_CONFIG_SD_PATH,
+                                 ECU_CONFIG_MAX_FILE_SIZE, &size);
+    if (text == NULL) return;
+
+    unsigned bad_line = ecu_input_configure((const char *)text, size);
+    if (bad_line != 0)
+        DLOG_WARN(ECU_CONFIG_SD_PATH ":%u: syntax error, using defaults",
+                  bad_line);
+    free(text);
+}
 
-/* ======================================================================
- * ECU_ME442 — CAN path (core 1 drains CAN + parses, core 0 just reads)
- * ====================================================================== */
-#if ECU_PROTOCOL == ECU_ME442
+/* Bit rate found by the last CAN auto-baud, tried first this time */
+static uint32_t saved_can_bitrate;
 
-static void core1_entry(void)
+static void load_can_bitrate_from_sd(void)
 {
-    bsp_can_init();     /* PIO0 IRQ is registered on core 1 NVIC */
+    uint32_t size;
+    uint8_t *text = read_sd_file(CAN_BITRATE_SD_PATH, 15, &size);
+    if (text == NULL) return;
+
+    char buf[16];
+    memcpy(buf, text, size);
+    buf[size] = '\0';
+    uint32_t rate = strtoul(buf, NULL, 10);
+    if (bsp_can_bitrate_valid(rate)) {
+        saved_can_bitrate = rate;
+        ecu_input_set_can_hint(rate);
+    } else {
+        DLOG_WARN(CAN_BITRATE_SD_PATH ": %lu is not a CAN bit rate",
+                  (unsigned long)rate);
+    }
+    free(text);
+}
 
-    bsp_can_frame_t frame;
-    while (true) {
-        while (bsp_can_recv(&frame))
-            invent_ems_feed_can_frame(frame.id, frame.data, frame.dlc);
-        tight_loop_contents();
+/* LVGL timer: once auto-baud locks, remember the rate (core 0 owns the
+ * file system, so core 1 only reports it).  A fixed rate is not saved. */
+static void can_bitrate_save_cb(lv_timer_t *timer)
+{
+    uint32_t rate = bsp_can_bitrate();
+    if (rate == 0) return;
+
+    if (bsp_can_autobaud() && rate != saved_can_bitrate) {
+        char buf[16];
+        uint32_t len = (uint32_t)snprintf(buf, sizeof(buf), "%lu\n",
+                                          (unsigned long)rate);
+        lv_fs_file_t f;
+        if (lv_fs_open(&f, CAN_BITRATE_SD_PATH, LV_FS_MODE_WR) == LV_FS_RES_OK) {
+            uint32_t written;
+            lv_fs_write(&f, buf, len, &written);
+            lv_fs_close(&f);
+        }
+        saved_can_bitrate = rate;
     }
+    lv_timer_del(timer);
 }
 
-#endif /* ECU_ME442 */
+/* Replace the built-in CAN decode tables with a .cdb file, if present */
+static void load_can_dbc_from_sd(void)
+{
+    static can_dbc_t sd_dbc;
+
+    uint32_t size;
+    uint8_t *blob = read_sd_file(CAN_DBC_SD_PATH,
+                                 CAN_DBC_MAX_FILE_SIZE, &size);
+    if (blob == NULL) return;
+
+    if (!can_dbc_load(blob, size, invent_ems_resolve_channel, &sd_dbc)) {
+        DLOG_WARN(CAN_DBC_SD_PATH ": invalid, using built-in tables");
+    } else if (!invent_ems_set_can_dbc(&sd_dbc)) {
+        DLOG_WARN(CAN_DBC_SD_PATH ": too many conversions, using built-in tables");
+        can_dbc_free(&sd_dbc);
+    }
+    free(blob);     /* tables are copied out by can_dbc_load() */
+}
 
 /* ======================================================================
  * LVGL timer callbacks (run inside lv_timer_handler on core 0)
  * ====================================================================== */
 
-/* Flag set by main loop when the protocol parser signals new data.
- * The LVGL timer reads it so that widget updates stay inside the
- * lv_timer_handler() context (required for correct dirty-area tracking). */
-static volatile bool ecu_data_ready = false;
-
+/* Gauges and the channel each one shows */
+static const struct {
+    invent_ems_channel_t ch;
+    void (*set)(float);
+} gauges[] = {
+    { INVENT_EMS_CH_oil_pressure, ui_dashboard_set_oil_pressure },
+    { INVENT_EMS_CH_clt,          ui_dashboard_set_coolant_temp },
+    { INVENT_EMS_CH_oil_temp,     ui_dashboard_set_oil_temp },
+};
+
+/* Widget updates stay inside the lv_timer_handler() context (required
+ * for correct dirty-area tracking); the snapshot is taken here too, so
+ * the gauges always show one consistent publish.  Only gauges whose
+ * channel changed since the last rendered generation are touched, and a
+ * channel that stops arriving blanks its gauge. */
 static void dashboard_update_cb(lv_timer_t *timer)
 {
     (void)timer;
-    if (!ecu_data_ready) return;
-    ecu_data_ready = false;
+    static uint32_t seen_gen;               /* generation on screen */
+    static uint32_t stale = ~0u;            /* gauges showing "--" */
 
+    invent_ems_acquire();
     const invent_ems_data_t *ecu = invent_ems_get_data();
-    ui_dashboard_set_oil_pressure(ecu->oil_pressure);
-    ui_dashboard_set_coolant_temp(ecu->clt);
-    ui_dashboard_set_oil_temp(ecu->oil_temp);
+    uint32_t now = time_us_32();
+    bool redrawn = false;
+
+    for (unsigned i = 0; i < sizeof(gauges) / sizeof(gauges[0]); i++) {
+        uint32_t bit = 1u << i;
+        if (invent_ems_age_us(gauges[i].ch, now) >
+            ECU_CHANNEL_STALE_MS * 1000u) {
+            if (!(stale & bit)) {
+                gauges[i].set(NAN);
+                stale |= bit;
+            }
+        } else if ((stale & bit) ||
+                   invent_ems_changed(gauges[i].ch, seen_gen)) {
+            gauges[i].set(invent_ems_value(ecu, gauges[i].ch));
+            stale &= ~bit;
+            redrawn = true;
+        }
+    }
+    seen_gen = ecu->generation;
+    latency_ui(ecu->generation, redrawn);
 }
 
 #if ENABLE_DEBUG_CONSOLE
@@ -131,22 +242,177 @@ static void debug_stats_cb(lv_timer_t *timer)
     const invent_ems_data_t *ecu = invent_ems_get_data();
 
     bsp_can_stats_t can = {0};
-#if ECU_PROTOCOL == ECU_ME442
-    can = bsp_can_get_stats();
-    can.rx_pin_raw = (sio_hw->gpio_in & (1u << BSP_CAN_GPIO_RX)) ? 1 : 0;
+    if (ecu_input_enabled(INVENT_EMS_SRC_CAN)) {
+        can = bsp_can_get_stats();
+        can.rx_pin_raw = (sio_hw->gpio_in & (1u << BSP_CAN_GPIO_RX)) ? 1 : 0;
+    }
+
+    invent_ems_snapshot_stats_t snap = invent_ems_get_snapshot_stats();
+
+    latency_summary_t lat[LATENCY_STAGE_COUNT] = {};
+#if ENABLE_LATENCY_TRACE
+    latency_get_summary(lat);
 #endif
 
+    exec_stats_t exec;
+    exec_get_stats(&exec);
+
     ui_debug_console_update_stats(
-        ecu->packet_count, ecu->error_count, ecu->connected, &can);
+        ecu->packet_count, ecu->error_count, ecu->connected, &can, &snap,
+        lat, &exec);
+
+#if ENABLE_RENDER_PERF
+    /* Drained every tick so the page opens on a fresh window */
+    render_perf_stats_t perf;
+    render_perf_get_stats(&perf);
+
+    mem_stats_t mem = {};
+#if ENABLE_MEM_WATCH
+    mem_watch_get_stats(&mem);
+#endif
+    ui_debug_console_update_perf(&perf, &exec, &mem);
+#endif
 }
 #endif /* ENABLE_DEBUG_CONSOLE */
 
+#if ENABLE_DLOG
+/* Binary log sinks: a file on the SD card (appended across boots) and
+ * USB CDC.  The USB stdio driver is only used for its raw output, so
+ * stray printf text never lands in the binary stream. */
+static lv_fs_file_t dlog_file;
+static bool         dlog_file_open;
+static uint32_t     dlog_unsynced;          /* bytes since the last reopen */
+
+/* Read-write opens keep the file (write-only truncates): append */
+static void dlog_open_file(void)
+{
+    dlog_file_open = DLOG_SD_PATH[0] != '\0' &&
+        lv_fs_open(&dlog_file, DLOG_SD_PATH,
+                   LV_FS_MODE_WR | LV_FS_MODE_RD) == LV_FS_RES_OK;
+    if (dlog_file_open)
+        lv_fs_seek(&dlog_file, 0, LV_FS_SEEK_END);
+}
+
+static void dlog_init_sinks(void)
+{
+#if DLOG_USB
+    stdio_set_driver_enabled(&stdio_usb, false);
+#endif
+    dlog_open_file();
+}
+
+static void dlog_sink(const void *data, uint32_t len)
+{
+#if DLOG_USB
+    if (stdio_usb_connected())
+        stdio_usb.out_chars((const char *)data, (int)len);
+#endif
+    if (dlog_file_open) {
+        uint32_t written;
+        lv_fs_write(&dlog_file, data, len, &written);
+    }
+}
+
+static void dlog_drain_cb(lv_timer_t *timer)
+{
+    (void)timer;
+    dlog_unsynced += dlog_drain(dlog_sink);
+}
+
+/* FatFS only commits the directory entry on close */
+static void dlog_sync_cb(lv_timer_t *timer)
+{
+    (void)timer;
+    if (!dlog_file_open || dlog_unsynced == 0) return;
+    lv_fs_close(&dlog_file);
+    dlog_open_file();
+    dlog_unsynced = 0;
+}
+#endif /* ENABLE_DLOG */
+
+#if ENABLE_TRACE_SPAN || ENABLE_PROFILER
+/* Long press: dump the span trace and the profile, each to the next
+ * free numbered file, so the dumps of earlier presses are kept */
+static lv_fs_file_t dump_file;
+
+static bool dump_open_next(const char *fmt)
+{
+    char path[32];
+    for (unsigned i = 0; i < TRACE_SD_MAX_FILES; i++) {
+        snprintf(path, sizeof(path), fmt, i);
+        if (lv_fs_open(&dump_file, path, LV_FS_MODE_RD) == LV_FS_RES_OK) {
+            lv_fs_close(&dump_file);
+            continue;                       /* taken */
+        }
+        /* fails only without a card */
+        return lv_fs_open(&dump_file, path, LV_FS_MODE_WR) == LV_FS_RES_OK;
+    }
+    DLOG_WARN("dump: no free file name for %s", fmt);
+    return false;
+}
+
+static void dump_sink(const void *data, uint32_t len)
+{
+    uint32_t written;
+    lv_fs_write(&dump_file, data, len, &written);
+}
+
+#if ENABLE_TRACE_SPAN
+static void trace_sink(const char *data, uint32_t len)
+{
+    dump_sink(data, len);
+}
+#endif
+
+static void diag_dump_cb(lv_event_t *e)
+{
+    (void)e;
+#if ENABLE_TRACE_SPAN
+    if (dump_open_next(TRACE_SD_PATH)) {
+        uint32_t events = trace_span_export_json(trace_sink);
+        lv_fs_close(&dump_file);
+        DLOG_INFO("trace: %u events written", events);
+    }
+#endif
+#if ENABLE_PROFILER
+    if (dump_open_next(PROFILER_SD_PATH)) {
+        uint32_t samples = profiler_export(dump_sink);
+        lv_fs_close(&dump_file);
+        DLOG_INFO("profile: %u samples written", samples);
+    }
+#endif
+}
+#endif /* ENABLE_TRACE_SPAN || ENABLE_PROFILER */
+
+#if ENABLE_LATENCY_TRACE && LATENCY_EXPORT_MS
+/* Rewrite the latency CSV on the SD card when new traces completed */
+static void latency_export_cb(lv_timer_t *timer)
+{
+    (void)timer;
+    static uint32_t exported;
+    static char csv[4096];
+
+    uint32_t done = latency_completed();
+    if (done == exported) return;
+    exported = done;
+
+    uint32_t len = (uint32_t)latency_export_csv(csv, sizeof(csv));
+    lv_fs_file_t f;
+    if (lv_fs_open(&f, LATENCY_EXPORT_SD_PATH, LV_FS_MODE_WR) != LV_FS_RES_OK)
+        return;
+    uint32_t written;
+    lv_fs_write(&f, csv, len, &written);
+    lv_fs_close(&f);
+}
+#endif
+
 /* ======================================================================
  * main
  * ====================================================================== */
 
 int main()
 {
+    mem_watch_paint_core0();        /* before anything has used the stack */
     stdio_init_all();
     set_cpu_clock(CPU_CLOCK_MHZ);
     bsp_i2c_init();
@@ -162,46 +428,70 @@ int main()
 
     /* ---- Protocol init ---- */
     invent_ems_init();
+    ecu_input_init();
 
-#if ECU_PROTOCOL == ECU_INVENT_EMS
-    bsp_serial_init();
-    uart_set_baudrate(uart0, INVENT_EMS_BAUD_RATE);
-    irq_set_exclusive_handler(UART0_IRQ, uart0_irq_handler);
-    irq_set_enabled(UART0_IRQ, true);
-    uart_set_irqs_enabled(uart0, true, false);
-#elif ECU_PROTOCOL == ECU_ME442
-    multicore_launch_core1(core1_entry);
+    lv_port_fs_init();
+#if ENABLE_DLOG
+    dlog_init_sinks();
 #endif
+    DLOG_INFO("boot: sys clock %u MHz", clock_get_hz(clk_sys) / MHZ);
+    load_ecu_config_from_sd();
+    if (ecu_input_enabled(INVENT_EMS_SRC_CAN)) {
+        load_can_dbc_from_sd();
+        load_can_bitrate_from_sd();
+    }
+
+    mem_watch_paint_core1();
+    multicore_launch_core1(ecu_input_run);
 
     /* ---- UI init ---- */
     ui_dashboard_init();
     ui_debug_console_init();
+#if ENABLE_TRACE_SPAN || ENABLE_PROFILER
+    lv_obj_add_flag(lv_scr_act(), LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(lv_scr_act(), diag_dump_cb, LV_EVENT_LONG_PRESSED,
+                        NULL);
+#endif
 
-    lv_timer_create(dashboard_update_cb, DASHBOARD_UPDATE_MS, NULL);
+    lv_timer_t *dashboard_timer =
+        lv_timer_create(dashboard_update_cb, DASHBOARD_UPDATE_MS, NULL);
 #if ENABLE_DEBUG_CONSOLE
     lv_timer_create(debug_stats_cb, DEBUG_STATS_UPDATE_MS, NULL);
 #endif
+    if (ecu_input_enabled(INVENT_EMS_SRC_CAN))
+        lv_timer_create(can_bitrate_save_cb, 500, NULL);
+#if ENABLE_LATENCY_TRACE && LATENCY_EXPORT_MS
+    lv_timer_create(latency_export_cb, LATENCY_EXPORT_MS, NULL);
+#endif
+#if ENABLE_DLOG
+    lv_timer_create(dlog_drain_cb, DLOG_DRAIN_MS, NULL);
+    lv_timer_create(dlog_sync_cb, DLOG_SD_SYNC_MS, NULL);
+#endif
 
-    /* ---- Super-loop ---- */
-    uint16_t sleep_ms_val = LVGL_TICK_PERIOD_MS;
+    profiler_start();
 
+    /* ---- Super-loop ----
+     * Sleep in WFE until the next LVGL timer is due, core 1 rings the
+     * doorbell (SEV) with a fresh ECU snapshot, which makes the
+     * dashboard update due at once, or the panel's TE pulse makes the
+     * refresh due.  The 1 ms tick interrupt also wakes the core; it
+     * just goes back to sleep. */
     while (true) {
-#if ECU_PROTOCOL == ECU_INVENT_EMS
-        /* Drain UART ring buffer → byte-level protocol parser */
-        uint16_t head = uart_rx_head;
-        while (uart_rx_tail != head) {
-            uint8_t byte = uart_rx_buf[uart_rx_tail];
-            uart_rx_tail = (uart_rx_tail + 1) % UART_RX_BUF_SIZE;
-            invent_ems_feed_byte(byte);
-        }
-#endif
-        /* Propagate "new ECU data" flag for the next LVGL timer tick */
-        if (invent_ems_has_new_data())
-            ecu_data_ready = true;
-
-        sleep_ms_val = lv_timer_handler();
-        if (sleep_ms_val > 500)             sleep_ms_val = 500;
-        if (sleep_ms_val < LVGL_TICK_PERIOD_MS) sleep_ms_val = LVGL_TICK_PERIOD_MS;
-        sleep_ms(sleep_ms_val);
+        TRACE_BEGIN("lv_timer_handler");
+        uint32_t wait_ms = lv_timer_handler();
+        TRACE_END("lv_timer_handler");
+        if (wait_ms > 500) wait_ms = 500;
+
+        uint32_t t_sleep = time_us_32();
+        absolute_time_t deadline = make_timeout_time_ms(wait_ms);
+        while (!invent_ems_available() && !lv_port_disp_vsync_pending() &&
+               !best_effort_wfe_or_timeout(deadline))
+            ;
+        render_perf_idle(time_us_32() - t_sleep);
+
+        lv_port_disp_vsync();
+
+        if (invent_ems_available())
+            lv_timer_ready(dashboard_timer);
     }
 }
@@ -0,0 +1,218 @@
+#include "can_dbc.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ---- Helpers ---- */
+
+static inline uint64_t load_le64(const uint8_t *d)
+{
+    uint64_t w = 0;
+    for (int i = 7; i >= 0; i--)
+        w = (w << 8) | d[i];
+    return w;
+}
+
+static inline uint64_t load_be64(const uint8_t *d)
+{
+    uint64_t w = 0;
+    for (int i = 0; i < 8; i++)
+        w = (w << 8) | d[i];
+    return w;
+}
+
+/** Extract the raw integer of one signal, sign-extended if signed. */
+static inline uint16_t unpack_signal(const can_dbc_signal_t *s,
+                                     uint64_t word_le, uint64_t word_be)
+{
+    uint64_t word = (s->flags & CAN_DBC_BIG_ENDIAN) ? word_be : word_le;
+    uint32_t mask = (1u << s->length) - 1;
+    uint32_t raw  = (uint32_t)(word >> s->shift) & mask;
+
+    if ((s->flags & CAN_DBC_SIGNED) && (raw & (1u << (s->length - 1))))
+        raw |= ~mask;                           /* sign-extend */
+    return (uint16_t)raw;
+}
+
+/** Multiplicative hash of a CAN ID into a power-of-two table. */
+static inline uint32_t hash_id(uint32_t id)
+{
+    return (id * 0x9E3779B1u) >> 16;
+}
+
+static inline uint32_t rd_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t rd_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline float rd_f32(const uint8_t *p)
+{
+    uint32_t u = rd_u32(p);
+    float f;
+    memcpy(&f, &u, 4);
+    return f;
+}
+
+/* CRC-32 (IEEE 802.3, reflected) — load time only, so bitwise is fine */
+static uint32_t crc32(const uint8_t *p, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+    return ~crc;
+}
+
+/* ---- Public API ---- */
+
+const can_dbc_message_t *can_dbc_find(const can_dbc_t *db, uint32_t id)
+{
+    if (db->hash != NULL) {
+        uint32_t slot = hash_id(id) & db->hash_mask;
+        uint16_t idx;
+        while ((idx = db->hash[slot]) != 0) {
+            if (db->messages[idx - 1].id == id)
+                return &db->messages[idx - 1];
+            slot = (slot + 1) & db->hash_mask;
+        }
+        return NULL;
+    }
+
+    uint16_t lo = 0, hi = db->message_count;
+    while (lo < hi) {
+        uint16_t mid = (uint16_t)((lo + hi) / 2);
+        uint32_t mid_id = db->messages[mid].id;
+        if (mid_id == id)   return &db->messages[mid];
+        if (mid_id < id)    lo = mid + 1;
+        else                hi = mid;
+    }
+    return NULL;
+}
+
+bool can_dbc_decode(const can_dbc_t *db, uint32_t id,
+                    const uint8_t *data, uint8_t dlc, uint16_t *raw,
+                    const uint32_t *accept, uint32_t *updated)
+{
+    const can_dbc_message_t *msg = can_dbc_find(db, id);
+    if (msg == NULL) return false;
+
+    /* Zero-pad short frames so the 64-bit loads never over-read */
+    uint8_t payload[8] = {0};
+    memcpy(payload, data, dlc > 8 ? 8 : dlc);
+
+    uint64_t word_le = load_le64(payload);
+    uint64_t word_be = load_be64(payload);
+
+    const can_dbc_signal_t *s = &db->signals[msg->first_signal];
+    for (uint8_t i = 0; i < msg->signal_count; i++, s++) {
+        if (s->min_dlc > dlc) continue;
+        if (accept != NULL &&
+            !((accept[s->channel >> 5] >> (s->channel & 31)) & 1))
+            continue;
+        raw[s->channel] = unpack_signal(s, word_le, word_be);
+        if (updated != NULL)
+            updated[s->channel >> 5] |= 1u << (s->channel & 31);
+    }
+    return true;
+}
+
+bool can_dbc_load(const uint8_t *blob, size_t len,
+                  can_dbc_resolve_cb_t resolve, can_dbc_t *db)
+{
+    if (len < CAN_DBC_FILE_HDR_SIZE ||
+        memcmp(blob, CAN_DBC_FILE_MAGIC, 4) != 0)
+        return false;
+
+    uint16_t msg_count = rd_u16(&blob[4]);
+    uint16_t sig_count = rd_u16(&blob[6]);
+    uint16_t str_size  = rd_u16(&blob[8]);
+    uint32_t crc       = rd_u32(&blob[12]);
+
+    size_t body = (size_t)msg_count * CAN_DBC_FILE_MSG_SIZE +
+                  (size_t)sig_count * CAN_DBC_FILE_SIG_SIZE + str_size;
+    if (msg_count == 0 || len != CAN_DBC_FILE_HDR_SIZE + body)
+        return false;
+    if (crc32(&blob[CAN_DBC_FILE_HDR_SIZE], body) != crc)
+        return false;
+
+    const uint8_t *mp = &blob[CAN_DBC_FILE_HDR_SIZE];
+    const uint8_t *sp = mp + (size_t)msg_count * CAN_DBC_FILE_MSG_SIZE;
+    const char    *strtab = (const char *)(sp + (size_t)sig_count *
+                                                CAN_DBC_FILE_SIG_SIZE);
+    if (str_size == 0 || strtab[str_size - 1] != '\0')
+        return false;
+
+    /* Hash table at most half full → short probe chains */
+    uint32_t hash_size = 1;
+    while (hash_size < 2u * msg_count) hash_size <<= 1;
+    if (hash_size > 0x10000u)
+        return false;
+
+    can_dbc_message_t *msgs = malloc(msg_count * sizeof(*msgs));
+    can_dbc_signal_t  *sigs = malloc(sig_count * sizeof(*sigs) + 1);
+    uint16_t          *hash = calloc(hash_size, sizeof(*hash));
+    if (msgs == NULL || sigs == NULL || hash == NULL)
+        goto fail;
+
+    for (uint16_t i = 0; i < sig_count; i++, sp += CAN_DBC_FILE_SIG_SIZE) {
+        can_dbc_signal_t *s = &sigs[i];
+        uint16_t name = rd_u16(&sp[8]);
+        if (name >= str_size || !resolve(&strtab[name], &s->channel))
+            goto fail;
+        s->scale   = rd_f32(&sp[0]);
+        s->offset  = rd_f32(&sp[4]);
+        s->shift   = sp[10];
+        s->length  = sp[11];
+        s->flags   = sp[12];
+        s->min_dlc = sp[13];
+        if (s->length == 0 || s->length > CAN_DBC_MAX_SIGNAL_BITS ||
+            s->shift + s->length > 64)
+            goto fail;
+    }
+
+    for (uint16_t i = 0; i < msg_count; i++, mp += CAN_DBC_FILE_MSG_SIZE) {
+        can_dbc_message_t *m = &msgs[i];
+        m->id           = rd_u32(&mp[0]);
+        m->first_signal = rd_u16(&mp[4]);
+        m->signal_count = mp[6];
+        if ((uint32_t)m->first_signal + m->signal_count > sig_count)
+            goto fail;
+
+        uint32_t slot = hash_id(m->id) & (hash_size - 1);
+        while (hash[slot] != 0) {
+            if (msgs[hash[slot] - 1].id == m->id)
+                goto fail;                      /* duplicate ID */
+            slot = (slot + 1) & (hash_size - 1);
+        }
+        hash[slot] = (uint16_t)(i + 1);
+    }
+
+    db->messages      = msgs;
+    db->signals       = sigs;
+    db->message_count = msg_count;
+    db->signal_count  = sig_count;
+    db->hash          = hash;
+    db->hash_mask     = (uint16_t)(hash_size - 1);
+    return true;
+
+fail:
+    free(msgs);
+    free(sigs);
+    free(hash);
+    return false;
+}
+
+void can_dbc_free(can_dbc_t *db)
+{
+    free((void *)db->messages);
+    free((void *)db->signals);
+    free((void *)db->hash);
+    memset(db, 0, sizeof(*db));
+}
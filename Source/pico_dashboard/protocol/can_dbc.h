@@ -0,0 +1,117 @@
+#ifndef CAN_DBC_H
+#define CAN_DBC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Table-driven CAN signal decoder
+ *
+ * A DBC file is compiled at build time (tools/dbc2c.py) into const
+ * descriptor tables that live in flash.  Each message descriptor points
+ * at a contiguous run of signal descriptors; messages are sorted by ID
+ * so the dispatch is a binary search.  The unpacker is generic — no
+ * per-message code is ever written by hand.
+ *
+ * Bit positions are pre-normalised by the generator: `shift` is the
+ * position of the signal's LSB inside the 64-bit payload word, loaded
+ * little-endian for Intel signals and big-endian for Motorola signals.
+ *
+ * The decoder only extracts raw integers, indexed by an application
+ * channel ID; scale/offset are carried along for the consumer to apply
+ * when (and if) the value is read.
+ */
+
+/* ---- Signal flags ---- */
+#define CAN_DBC_SIGNED      0x01    /* two's-complement raw value       */
+#define CAN_DBC_BIG_ENDIAN  0x02    /* Motorola byte order (@0)         */
+
+/* Raw values are stored as 16-bit integers (sign-extended if signed) */
+#define CAN_DBC_MAX_SIGNAL_BITS 16
+
+typedef struct {
+    float    scale;         /* physical = raw * scale + offset     */
+    float    offset;
+    uint8_t  channel;       /* application channel ID (0-255)      */
+    uint8_t  shift;         /* LSB position in the payload word    */
+    uint8_t  length;        /* signal width in bits (1-16)         */
+    uint8_t  flags;         /* CAN_DBC_SIGNED | CAN_DBC_BIG_ENDIAN */
+    uint8_t  min_dlc;       /* bytes needed to contain the signal  */
+} can_dbc_signal_t;
+
+typedef struct {
+    uint32_t id;
+    uint16_t first_signal;  /* index into can_dbc_t.signals        */
+    uint8_t  signal_count;
+} can_dbc_message_t;
+
+typedef struct {
+    const can_dbc_message_t *messages;      /* sorted by id */
+    const can_dbc_signal_t  *signals;
+    uint16_t                 message_count;
+    uint16_t                 signal_count;
+
+    /* Optional open-addressing ID index built by can_dbc_load():
+     * slot = message index + 1, 0 = empty.  NULL → binary search. */
+    const uint16_t          *hash;
+    uint16_t                 hash_mask;
+} can_dbc_t;
+
+/*
+ * Binary table file (.cdb) written by `tools/dbc2c.py --bin`, all fields
+ * little-endian:
+ *
+ *   header   magic "CDB1", u16 message_count, u16 signal_count,
+ *            u16 strtab_size, u16 reserved, u32 CRC-32 of the body
+ *   body     message_count x { u32 id, u16 first_signal, u8 count, u8 pad }
+ *            signal_count  x { f32 scale, f32 offset, u16 field_name,
+ *                              u8 shift, u8 length, u8 flags, u8 min_dlc,
+ *                              u16 pad }
+ *            strtab        NUL-terminated target field names
+ *
+ * Targets are stored by name so a table stays valid across firmware
+ * builds; they are resolved to channel IDs once, at load time.
+ */
+#define CAN_DBC_FILE_MAGIC      "CDB1"
+#define CAN_DBC_FILE_HDR_SIZE   16
+#define CAN_DBC_FILE_MSG_SIZE   8
+#define CAN_DBC_FILE_SIG_SIZE   16
+
+/* Map a target channel name to its ID; return false if unknown. */
+typedef bool (*can_dbc_resolve_cb_t)(const char *name, uint8_t *channel);
+
+/* Find the descriptor for `id`, or NULL if the database does not list it. */
+const can_dbc_message_t *can_dbc_find(const can_dbc_t *db, uint32_t id);
+
+/*
+ * Extract every signal of frame `id` into raw[channel].  Signals that do
+ * not fit in `dlc` bytes are skipped, and so are channels whose bit is
+ * clear in `accept` (NULL = every channel).  If `updated` is not NULL,
+ * bit `channel` is set in it for every signal stored.
+ * Returns true if the ID was recognised.
+ */
+bool can_dbc_decode(const can_dbc_t *db, uint32_t id,
+                    const uint8_t *data, uint8_t dlc, uint16_t *raw,
+                    const uint32_t *accept, uint32_t *updated);
+
+/*
+ * Parse a .cdb image into heap-allocated tables and build the ID hash.
+ * Returns false (and leaves *db untouched) on a malformed or corrupt
+ * file, or if any target field cannot be resolved.
+ */
+bool can_dbc_load(const uint8_t *blob, size_t len,
+                  can_dbc_resolve_cb_t resolve, can_dbc_t *db);
+
+/* Release the tables of a database filled by can_dbc_load(). */
+void can_dbc_free(can_dbc_t *db);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CAN_DBC_H */
@@ -0,0 +1,397 @@
+#include "ecu_input.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/uart.h"
+
+#include "config.h"
+#include "bsp_serial.h"
+#include "bsp_can.h"
+#include "trace_span.h"
+#include "latency_trace.h"
+#include "exec.h"
+#include "profiler.h"
+
+/* ======================================================================
+ * Invent EMS over UART0
+ * ====================================================================== */
+
+/*
+ * UART0 RX DMA ring.
+ * A DMA channel paced by the UART RX DREQ copies every byte into an
+ * aligned power-of-two buffer, wrapping its write address in hardware,
+ * so receiving costs no CPU time at all.  The consumer finds new data
+ * by reading the channel's write pointer.  1 KiB holds ~530 ms of
+ * traffic at 19200 baud; only the consumer falling that far behind
+ * loses data (the oldest bytes are overwritten).
+ *
+ * The UART's RX and RX-timeout interrupts only see bytes left in its
+ * FIFO, so they cannot fire while the DMA empties it.  Once a poll finds
+ * the line quiet the RX DMA request is switched off and both interrupts
+ * armed: the next burst waits in the FIFO until 4 bytes or 32 bit times
+ * of silence raise the interrupt, which hands the FIFO back to the DMA
+ * and releases the UART task.  The task polls every ECU_UART_POLL_US
+ * while bytes flow and drops to the ECU_UART_IDLE_US watchdog once
+ * armed, so core 1 sleeps through a silent line.
+ */
+#define UART_RX_BUF_BITS 10
+#define UART_RX_BUF_SIZE (1u << UART_RX_BUF_BITS)
+static uint8_t  uart_rx_buf[UART_RX_BUF_SIZE]
+                __attribute__((aligned(UART_RX_BUF_SIZE)));
+static uint16_t uart_rx_tail = 0;
+static int      uart_rx_dma;
+static volatile bool uart_rx_armed;         /* waiting on the interrupt */
+
+static exec_task_t source_task[INVENT_EMS_SRC_COUNT];
+
+#define UART_RX_IRQ_BITS    (UART_UARTIMSC_RXIM_BITS | UART_UARTIMSC_RTIM_BITS)
+
+/* Wake-up: give the FIFO back to the DMA.  Also run from the task, which
+ * the interrupt can preempt; every step is idempotent. */
+static void uart_rx_disarm(void)
+{
+    uart_hw_t *hw = uart_get_hw(uart0);
+    hw_clear_bits(&hw->imsc, UART_RX_IRQ_BITS);
+    hw->icr = UART_UARTICR_RXIC_BITS | UART_UARTICR_RTIC_BITS;
+    hw_set_bits(&hw->dmacr, UART_UARTDMACR_RXDMAE_BITS);
+    uart_rx_armed = false;
+}
+
+static void uart_rx_irq(void)
+{
+    uart_rx_disarm();
+    exec_signal(&source_task[INVENT_EMS_SRC_UART]);
+}
+
+/* Line quiet: bytes stay in the FIFO and raise the interrupt */
+static void uart_rx_arm(void)
+{
+    uart_hw_t *hw = uart_get_hw(uart0);
+    uart_rx_armed = true;
+    hw_clear_bits(&hw->dmacr, UART_UARTDMACR_RXDMAE_BITS);
+    hw_set_bits(&hw->imsc, UART_RX_IRQ_BITS);
+}
+
+static uint16_t uart_rx_head(void)
+{
+    return (uint16_t)((dma_hw->ch[uart_rx_dma].write_addr -
+                       (uintptr_t)uart_rx_buf) & (UART_RX_BUF_SIZE - 1));
+}
+
+static void uart_rx_dma_start(void)
+{
+#if PICO_RP2350
+    uint32_t count = dma_encode_endless_transfer_count();
+#else
+    uint32_t count = 0xFFFFFFFFu;           /* re-armed by poll when done */
+#endif
+    dma_channel_set_trans_count(uart_rx_dma, count, true);
+}
+
+static void uart_source_init(void)
+{
+    bsp_serial_init();
+    uart_set_baudrate(uart0, INVENT_EMS_BAUD_RATE);
+
+    uart_rx_dma = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(uart_rx_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, UART_RX_BUF_BITS);
+    channel_config_set_dreq(&c, uart_get_dreq(uart0, false));
+    dma_channel_configure(uart_rx_dma, &c, uart_rx_buf,
+                          &uart_get_hw(uart0)->dr, 0, false);
+    uart_rx_dma_start();
+
+    /* RX interrupt at 1/8 full (4 bytes); on this core's NVIC */
+    hw_write_masked(&uart_get_hw(uart0)->ifls,
+                    0u << UART_UARTIFLS_RXIFLSEL_LSB,
+                    UART_UARTIFLS_RXIFLSEL_BITS);
+    irq_set_exclusive_handler(UART0_IRQ, uart_rx_irq);
+    irq_set_enabled(UART0_IRQ, true);
+    uart_rx_arm();
+}
+
+/* Parse the ring in place, in at most two contiguous spans (before and
+ * after the wrap point) */
+static bool uart_source_poll(void)
+{
+    uint16_t head = uart_rx_head();
+#if !PICO_RP2350
+    if (!dma_channel_is_busy(uart_rx_dma))
+        uart_rx_dma_start();
+#endif
+    if (head == uart_rx_tail) {
+        if (uart_rx_armed)
+            return false;
+        uart_rx_arm();
+        /* A byte the DMA took just before the request went off */
+        head = uart_rx_head();
+        if (head == uart_rx_tail) {
+            exec_set_period(&source_task[INVENT_EMS_SRC_UART],
+                            ECU_UART_IDLE_US);
+            return false;
+        }
+        uart_rx_disarm();
+    }
+    if (source_task[INVENT_EMS_SRC_UART].period_us != ECU_UART_POLL_US)
+        exec_set_period(&source_task[INVENT_EMS_SRC_UART], ECU_UART_POLL_US);
+    latency_rx(time_us_32());
+
+    TRACE_BEGIN("uart_parse");
+    if (head < uart_rx_tail) {
+        invent_ems_feed_bytes(&uart_rx_buf[uart_rx_tail],
+                              UART_RX_BUF_SIZE - uart_rx_tail);
+        uart_rx_tail = 0;
+    }
+    if (head > uart_rx_tail) {
+        invent_ems_feed_bytes(&uart_rx_buf[uart_rx_tail],
+                              head - uart_rx_tail);
+        uart_rx_tail = head;
+    }
+    TRACE_END("uart_parse");
+    return true;
+}
+
+/* ======================================================================
+ * ME442 over CAN (PIO0)
+ * ====================================================================== */
+
+static uint32_t can_bitrate = ECU_CAN_BITRATE;     /* 0 = auto */
+static uint32_t can_hint;
+static bool     can_mailbox = ECU_CAN_RX_MAILBOX;
+
+static void can_rx_notify(void)
+{
+    exec_signal(&source_task[INVENT_EMS_SRC_CAN]);
+}
+
+static void can_source_init(void)
+{
+    /* One mailbox per message the decoder knows; if the tables list
+     * more IDs than there are mailboxes the driver stays in FIFO mode */
+    const can_dbc_t *db = invent_ems_get_can_dbc();
+    if (can_mailbox && db->message_count <= BSP_CAN_MAILBOX_COUNT) {
+        uint32_t ids[BSP_CAN_MAILBOX_COUNT];
+        for (uint16_t i = 0; i < db->message_count; i++)
+            ids[i] = db->messages[i].id;
+        bsp_can_set_mailboxes(ids, (uint8_t)db->message_count);
+    }
+
+    /* Every frame releases the CAN task at once */
+    bsp_can_set_rx_notify(can_rx_notify);
+
+    /* PIO0 IRQ is registered on the calling core */
+    bsp_can_init(can_bitrate, can_hint);
+}
+
+static bool can_source_poll(void)
+{
+    bsp_can_frame_t frame;
+    bool any = false;
+
+    TRACE_BEGIN("can_decode");
+    while (bsp_can_recv(&frame)) {
+        latency_rx(frame.rx_us);
+        invent_ems_feed_can_frame(frame.id, frame.data, frame.dlc);
+        any = true;
+    }
+    TRACE_END("can_decode");
+    return any;
+}
+
+/* ======================================================================
+ * Source table & configuration
+ * ====================================================================== */
+
+static const ecu_source_t sources[INVENT_EMS_SRC_COUNT] = {
+    [INVENT_EMS_SRC_UART] = { "uart", uart_source_init, uart_source_poll,
+                              ECU_UART_IDLE_US },
+    [INVENT_EMS_SRC_CAN]  = { "can",  can_source_init,  can_source_poll,
+                              ECU_CAN_POLL_US },
+};
+
+static bool enabled[INVENT_EMS_SRC_COUNT];
+
+static int source_by_name(const char *name)
+{
+    for (int i = 0; i < INVENT_EMS_SRC_COUNT; i++)
+        if (strcmp(sources[i].name, name) == 0)
+            return i;
+    return -1;
+}
+
+void ecu_input_init(void)
+{
+    enabled[INVENT_EMS_SRC_UART] = ECU_SOURCE_UART;
+    enabled[INVENT_EMS_SRC_CAN]  = ECU_SOURCE_CAN;
+
+    for (int i = 0; i < INVENT_EMS_CH_COUNT; i++)
+        invent_ems_set_preferred((invent_ems_channel_t)i,
+                                 ECU_SOURCE_PREFERRED);
+}
+
+unsigned ecu_input_configure(const char *text, size_t len)
+{
+    bool     en[INVENT_EMS_SRC_COUNT];
+    uint8_t  pref[INVENT_EMS_CH_COUNT];
+    bool     pref_set[INVENT_EMS_CH_COUNT];
+    uint32_t bitrate = can_bitrate;
+    bool     mailbox = can_mailbox;
+
+    memcpy(en, enabled, sizeof(en));
+    memset(pref_set, 0, sizeof(pref_set));
+
+    /* Parse everything first so a bad file changes nothing */
+    unsigned lineno = 0;
+    size_t pos = 0;
+    while (pos < len) {
+        char line[96];
+        size_t n = 0;
+        while (pos < len && text[pos] != '\n') {
+            if (n < sizeof(line) - 1)
+                line[n++] = text[pos];
+            pos++;
+        }
+        pos++;                              /* skip '\n' */
+        line[n] = '\0';
+        lineno++;
+
+        char *hash = strchr(line, '#');
+        if (hash != NULL) *hash = '\0';
+
+        char key[16], arg1[24], arg2[24];
+        int fields = sscanf(line, "%15s %23s %23s", key, arg1, arg2);
+        if (fields <= 0)
+            continue;                       /* blank / comment */
+
+        int src = source_by_name(key);
+        if (src >= 0 && fields == 2) {
+            if      (strcmp(arg1, "on")  == 0) en[src] = true;
+            else if (strcmp(arg1, "off") == 0) en[src] = false;
+            else return lineno;
+            continue;
+        }
+
+        if (strcmp(key, "can_bitrate") == 0 && fields == 2) {
+            char *end;
+            if (strcmp(arg1, "auto") == 0)
+                bitrate = BSP_CAN_BITRATE_AUTO;
+            else if ((bitrate = strtoul(arg1, &end, 10)) == 0 ||
+                     *end != '\0' || !bsp_can_bitrate_valid(bitrate))
+                return lineno;
+            continue;
+        }
+
+        if (strcmp(key, "can_rx") == 0 && fields == 2) {
+            if      (strcmp(arg1, "mailbox") == 0) mailbox = true;
+            else if (strcmp(arg1, "fifo")    == 0) mailbox = false;
+            else return lineno;
+            continue;
+        }
+
+        if (strcmp(key, "prefer") == 0 && fields == 3 &&
+            (src = source_by_name(arg1)) >= 0) {
+            if (strcmp(arg2, "*") == 0) {
+                memset(pref, src, sizeof(pref));
+                memset(pref_set, 1, sizeof(pref_set));
+                continue;
+            }
+            uint8_t ch;
+            if (!invent_ems_resolve_channel(arg2, &ch))
+                return lineno;
+            pref[ch] = (uint8_t)src;
+            pref_set[ch] = true;
+            continue;
+        }
+        return lineno;
+    }
+
+    memcpy(enabled, en, sizeof(enabled));
+    can_bitrate = bitrate;
+    can_mailbox = mailbox;
+    for (int i = 0; i < INVENT_EMS_CH_COUNT; i++)
+        if (pref_set[i])
+            invent_ems_set_preferred((invent_ems_channel_t)i,
+                                     (invent_ems_source_t)pref[i]);
+    return 0;
+}
+
+bool ecu_input_enabled(invent_ems_source_t src)
+{
+    return src < INVENT_EMS_SRC_COUNT && enabled[src];
+}
+
+void ecu_input_set_can_hint(uint32_t bitrate)
+{
+    can_hint = bitrate;
+}
+
+/* ======================================================================
+ * Core 1 tasks
+ * ====================================================================== */
+
+/* Drain deadline for signalled sources; a polled source's deadline is
+ * its period */
+#define SOURCE_DEADLINE_US   1000
+#define PUBLISH_DEADLINE_US  2000
+
+static exec_task_t publish_task;
+
+static void source_task_run(void *arg)
+{
+    const ecu_source_t *src = (const ecu_source_t *)arg;
+    if (src->poll())
+        exec_signal(&publish_task);
+}
+
+/* Lowest priority, so a burst drained by several source runs is
+ * published once */
+static void publish_task_run(void *arg)
+{
+    (void)arg;
+    uint32_t now = time_us_32();
+    TRACE_BEGIN("publish");
+    uint32_t gen = invent_ems_publish(now);
+    TRACE_END("publish");
+    if (gen != 0)
+        __sev();                            /* doorbell: wake core 0 */
+    latency_pass(gen, now);
+}
+
+void ecu_input_run(void)
+{
+    /* CAN first: its mailboxes/queue are the shortest buffer */
+    static const int order[] = { INVENT_EMS_SRC_CAN, INVENT_EMS_SRC_UART };
+
+    for (unsigned k = 0; k < sizeof(order) / sizeof(order[0]); k++) {
+        int i = order[k];
+        if (!enabled[i])
+            continue;
+        source_task[i] = (exec_task_t){
+            .name        = sources[i].name,
+            .run         = source_task_run,
+            .arg         = (void *)&sources[i],
+            .period_us   = sources[i].period_us,
+            .deadline_us = i == INVENT_EMS_SRC_CAN ? SOURCE_DEADLINE_US : 0,
+        };
+        exec_add(&source_task[i]);
+        sources[i].init();
+    }
+
+    publish_task = (exec_task_t){
+        .name        = "pub",
+        .run         = publish_task_run,
+        .deadline_us = PUBLISH_DEADLINE_US,
+    };
+    exec_add(&publish_task);
+
+    profiler_start();
+    exec_run();
+}
@@ -0,0 +1,64 @@
+#ifndef ECU_INPUT_H
+#define ECU_INPUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "invent_ems.h"
+
+/*
+ * ECU input layer
+ *
+ * Every enabled source is initialised and drained on core 1, straight
+ * into the protocol decoders (UART bytes out of the RX ring, CAN frames
+ * out of the driver queue); one invent_ems_publish() per pass hands the
+ * merged result to core 0.  Sources can run side by side — which one
+ * wins for a given channel is decided per channel by
+ * invent_ems_set_preferred().
+ *
+ * Defaults come from config.h (ECU_SOURCE_*) and can be overridden at
+ * boot by a text file (ECU_CONFIG_SD_PATH):
+ *
+ *   # comment
+ *   uart    on                 # enable/disable a source
+ *   can     on
+ *   can_bitrate auto           # or 125000 / 250000 / 500000 / 1000000
+ *   can_rx  mailbox            # or fifo (see bsp_can.h)
+ *   prefer  can  *             # preferred source for every channel
+ *   prefer  uart lambda        # ... and per channel (later lines win)
+ */
+
+typedef struct {
+    const char *name;           /* as used in the config file */
+    void (*init)(void);         /* core 1, once */
+    bool (*poll)(void);         /* drain all pending input; false if idle */
+    uint32_t    period_us;      /* poll period (sources may also signal) */
+} ecu_source_t;
+
+/* Load the config.h defaults (core 0, after invent_ems_init()) */
+void ecu_input_init(void);
+
+/* Apply a config file image.  On a syntax error nothing is changed and
+ * the 1-based number of the offending line is returned; 0 on success. */
+unsigned ecu_input_configure(const char *text, size_t len);
+
+bool ecu_input_enabled(invent_ems_source_t src);
+
+/* CAN bit rate to try first when auto-detecting (the last one found) */
+void ecu_input_set_can_hint(uint32_t bitrate);
+
+/* Core 1 entry point: init the enabled sources and run them on the
+ * core 1 executive (sched/exec.h), one task per source plus a publish
+ * task released whenever a source decoded something.  Every publish
+ * ends with a SEV so core 0 can sleep in WFE too. */
+void ecu_input_run(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ECU_INPUT_H */
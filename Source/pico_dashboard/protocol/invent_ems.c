@@ -1,17 +1,23 @@
 #include "invent_ems.h"
+#include "can_dbc_me442.h"
 #include <string.h>
 #include <math.h>
+#include <stdatomic.h>
 
 /*
  * Protocol wire format (after UART byte stream):
  *
  *   Header:  0x55 0x00 0xAA 0x00
  *   Version: 0x54
- *   Payload: rxbuf[0]=Length, rxbuf[1..Length-2]=data, rxbuf[Length-1..Length]=CRC16-LE
+ *   Payload: pkt[0]=Length, pkt[1..Length-2]=data, pkt[Length-1..Length]=CRC16-LE
  *
- * CRC16 (CCITT variant, init 0xFFFF) covers rxbuf[0] through rxbuf[Length-2].
+ * CRC16 (CCITT variant, init 0xFFFF) covers pkt[0] through pkt[Length-2].
  *
- * TInfoPacket layout in rxbuf (packed, little-endian):
+ * Packets are parsed in place, straight out of the caller's buffer; only
+ * a packet that straddles two invent_ems_feed_bytes() calls is staged in
+ * a small carry buffer.
+ *
+ * TInfoPacket layout in pkt (packed, little-endian):
  *   [0]  Length          uint8   (= sizeof(TInfoPacket) + 1, typically 37)
  *   [1]  Type            uint8
  *   [2]  Runlevel        uint8
@@ -44,22 +50,167 @@
 #define HEADER_2     0xAA
 #define HEADER_3     0x00
 
-#define MAX_RX_BUF   64
+#define HEADER_LEN      5    /* 4 sync bytes + protocol version */
 #define MAX_PACKET_LEN  48   /* max valid Length field */
 #define MIN_PACKET_LEN   4   /* minimum: type + at least 1 data + CRC16 */
+#define MAX_FRAME_LEN   (HEADER_LEN + 1 + MAX_PACKET_LEN)
 
+#define INFO_PACKET_LEN     37   /* Length of a full TInfoPacket */
 #define SLOW_PACKET_OFFSET  25
 #define SLOW_PACKET_SIZE    11
 #define SLOW_PACKET_COUNT   10
 
 /* ---- Parser state ---- */
-static uint8_t rxstate;
-static uint8_t rxbuf[MAX_RX_BUF];
-static uint8_t rxptr;
+static const uint8_t header[HEADER_LEN] = {
+    HEADER_0, HEADER_1, HEADER_2, HEADER_3, INVENT_EMS_PROTOCOL_VER
+};
+
+/* Partial frame carried over between invent_ems_feed_bytes() calls.
+ * Two frames deep so a carried prefix plus fresh input always holds at
+ * least one complete frame. */
+static uint8_t carry[2 * MAX_FRAME_LEN];
+static size_t  carry_len;
 
 /* ---- Data ---- */
+
+/* Working copy — only ever touched by the producer (parser / CAN decode) */
 static invent_ems_data_t ecu_data;
-static volatile bool new_data_flag;
+static bool pending;                /* ecu_data changed since last publish */
+static uint32_t touched[INVENT_EMS_CH_WORDS];   /* channels sampled since */
+
+/*
+ * Triple buffer between the producer and the UI core.
+ *
+ * The producer owns snap[back], the consumer owns snap[front]; the third
+ * index sits in `middle`, tagged with SNAP_FRESH when it holds a snapshot
+ * the consumer has not taken yet.  Each side hands its buffer over with a
+ * single atomic exchange, so neither side ever waits and the consumer
+ * always sees a complete snapshot — at worst one publish old.
+ */
+#define SNAP_FRESH  0x80u
+#define SNAP_INDEX  0x03u
+
+static invent_ems_data_t snap[3];
+static _Atomic uint8_t   middle;
+static uint8_t           back;      /* producer side */
+static uint8_t           front;     /* consumer side */
+static uint8_t           last;      /* most recent publish (producer-read) */
+
+static _Atomic uint32_t  publish_count;
+static _Atomic uint32_t  consume_count;
+
+/* CAN decode tables — built-in DBC unless replaced at boot */
+static const can_dbc_t *can_db = &can_dbc_me442;
+
+/* ---- Channel names (indexed by invent_ems_channel_t) ---- */
+#define CH_NAME(f)          #f,
+#define CH_NAME_IDX(f, i)   #f #i,
+
+static const char *const channel_names[INVENT_EMS_CH_COUNT] = {
+    INVENT_EMS_CHANNELS(CH_NAME, CH_NAME_IDX)
+};
+
+_Static_assert(INVENT_EMS_CH_COUNT <= 256, "can_dbc_signal_t.channel is 8 bits");
+
+/* ---- Raw → engineering-unit conversions ----
+ *
+ * uart_conv[] and can_conv[] index this table.  The first entries are
+ * the fixed scalings of the UART protocol; the CAN tables append one
+ * entry per distinct scale/offset pair in invent_ems_set_can_dbc().
+ * Written only before the producer starts, read-only afterwards.
+ */
+typedef enum {
+    KIND_NONE = 0,      /* no conversion → NaN */
+    KIND_UNSIGNED,      /* raw * scale + offset */
+    KIND_SIGNED,        /* (int16_t)raw * scale + offset */
+    KIND_RECIPROCAL,    /* scale / raw, 0 if raw == 0 */
+} conv_kind_t;
+
+typedef struct {
+    float   scale;
+    float   offset;
+    uint8_t kind;
+} conv_t;
+
+enum {
+    CONV_NONE = 0,
+    CONV_U,             /* unsigned, as-is */
+    CONV_S,             /* signed, as-is */
+    CONV_RPM,           /* 10000000 / period */
+    CONV_QDEG,          /* signed, 0.25 deg */
+    CONV_DIV16,         /* 1/16 */
+    CONV_INJ_MS,        /* 0.004 ms */
+    CONV_KNOCK_V,       /* 5/256 V */
+    CONV_PCT255,        /* 100/255 % */
+    CONV_PCT256,        /* 100/256 % */
+    CONV_X2,            /* 2 kPa */
+    CONV_LAMBDA,        /* 1/128 */
+    CONV_X0_1,
+    CONV_X0_01,
+    CONV_BUILTIN_COUNT
+};
+
+#define CONV_MAX    64
+
+static conv_t convs[CONV_MAX] = {
+    [CONV_NONE]    = { 0.0f,              0.0f, KIND_NONE },
+    [CONV_U]       = { 1.0f,              0.0f, KIND_UNSIGNED },
+    [CONV_S]       = { 1.0f,              0.0f, KIND_SIGNED },
+    [CONV_RPM]     = { 10000000.0f,       0.0f, KIND_RECIPROCAL },
+    [CONV_QDEG]    = { 0.25f,             0.0f, KIND_SIGNED },
+    [CONV_DIV16]   = { 1.0f / 16.0f,      0.0f, KIND_UNSIGNED },
+    [CONV_INJ_MS]  = { 0.004f,            0.0f, KIND_UNSIGNED },
+    [CONV_KNOCK_V] = { 5.0f / 256.0f,     0.0f, KIND_UNSIGNED },
+    [CONV_PCT255]  = { 100.0f / 255.0f,   0.0f, KIND_UNSIGNED },
+    [CONV_PCT256]  = { 100.0f / 256.0f,   0.0f, KIND_UNSIGNED },
+    [CONV_X2]      = { 2.0f,              0.0f, KIND_UNSIGNED },
+    [CONV_LAMBDA]  = { 1.0f / 128.0f,     0.0f, KIND_UNSIGNED },
+    [CONV_X0_1]    = { 0.1f,              0.0f, KIND_UNSIGNED },
+    [CONV_X0_01]   = { 0.01f,             0.0f, KIND_UNSIGNED },
+};
+
+/* Conversion of each channel per source.  A UART channel always uses
+ * the conversion named where it is parsed; put() records it, always the
+ * same value, before the channel's first publish. */
+static uint8_t uart_conv[INVENT_EMS_CH_COUNT];
+static uint8_t can_conv[INVENT_EMS_CH_COUNT];
+
+/* Per-channel tracking, shared by both cores (see invent_ems.h).  Only
+ * invent_ems_publish() writes them; single aligned words. */
+static uint32_t chan_gen[INVENT_EMS_CH_COUNT];  /* generation of last change */
+static uint32_t chan_us[INVENT_EMS_CH_COUNT];   /* time of last sample, 0 = never */
+
+/* ---- Source merge ---- */
+static uint8_t  preferred[INVENT_EMS_CH_COUNT];
+static uint32_t preferred_us[INVENT_EMS_CH_COUNT];  /* 0 = never seen */
+static uint32_t clock_us;                           /* as of last publish */
+
+/* Decide whether a sample of `ch` from `src` replaces the current value */
+static inline bool accept(unsigned ch, uint8_t src)
+{
+    if (src == preferred[ch]) {
+        preferred_us[ch] = clock_us | 1;
+        return true;
+    }
+    return preferred_us[ch] == 0 ||
+           clock_us - preferred_us[ch] > INVENT_EMS_FAILOVER_MS * 1000u;
+}
+
+/* accept(ch, INVENT_EMS_SRC_CAN) for every channel, as a mask, so CAN
+ * frames decode straight into ecu_data.raw[].  Exact between publishes:
+ * clock_us only moves in invent_ems_publish(), which rebuilds it, and a
+ * UART sample of a UART-preferred channel clears that channel's bit. */
+static uint32_t can_accept[INVENT_EMS_CH_WORDS];
+
+static void update_can_accept(void)
+{
+    memset(can_accept, 0, sizeof(can_accept));
+    for (unsigned ch = 0; ch < INVENT_EMS_CH_COUNT; ch++) {
+        if (preferred[ch] == INVENT_EMS_SRC_CAN || preferred_us[ch] == 0 ||
+            clock_us - preferred_us[ch] > INVENT_EMS_FAILOVER_MS * 1000u)
+            can_accept[ch >> 5] |= 1u << (ch & 31);
+    }
+}
 
 /* ---- Helpers ---- */
 static inline int16_t read_i16(const uint8_t *p) {
@@ -70,45 +221,95 @@ static inline uint16_t read_u16(const uint8_t *p) {
     return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
 }
 
-/* ---- CRC16-CCITT (matches Invent EMS firmware) ---- */
-static uint16_t checksum(const uint8_t *buf)
+static inline bool bit_get(const uint32_t *mask, unsigned ch)
+{
+    return (mask[ch >> 5] >> (ch & 31)) & 1;
+}
+
+/* Store one raw sample.  Signed sources are passed as int8_t/int16_t
+ * and land sign-extended in the 16-bit slot. */
+static inline void put(unsigned ch, uint16_t raw, uint8_t conv)
+{
+    if (!accept(ch, INVENT_EMS_SRC_UART))
+        return;
+    uint32_t bit = 1u << (ch & 31);
+    if (preferred[ch] == INVENT_EMS_SRC_UART)
+        can_accept[ch >> 5] &= ~bit;        /* preferred source is live */
+    ecu_data.raw[ch] = raw;
+    uart_conv[ch] = conv;
+    ecu_data.seen[ch >> 5]     |= bit;
+    ecu_data.from_can[ch >> 5] &= ~bit;
+    touched[ch >> 5] |= bit;
+}
+
+#define PUT(name, raw, conv)    put(INVENT_EMS_CH_##name, (raw), (conv))
+
+/* ---- CRC16-CCITT (matches Invent EMS firmware) ----
+ *
+ * Reflected CCITT (poly 0x8408, init 0xFFFF), one table lookup per byte.
+ * Bit-for-bit identical to the firmware's shift/xor formulation.
+ */
+static const uint16_t crc16_table[256] = {
+    0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
+    0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
+    0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
+    0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
+    0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
+    0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
+    0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
+    0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
+    0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
+    0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
+    0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
+    0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
+    0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
+    0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
+    0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
+    0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
+    0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
+    0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
+    0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
+    0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
+    0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
+    0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
+    0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
+    0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
+    0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
+    0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
+    0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
+    0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
+    0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
+    0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
+    0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
+    0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78,
+};
+
+static uint16_t checksum(const uint8_t *pkt)
 {
-    uint8_t len = buf[0] - 2;  /* CRC covers buf[0] through buf[len] */
-    if (len >= MAX_RX_BUF - 2) return 0;
+    uint8_t len = pkt[0] - 1;  /* CRC covers pkt[0] through pkt[len - 1] */
 
     uint16_t crc = 0xFFFF;
-    for (uint8_t i = 0; i <= len; i++) {
-        uint8_t d = buf[i];
-        d ^= (uint8_t)(crc & 0xFF);
-        d ^= (uint8_t)(d << 4);
-        uint16_t t = ((uint16_t)d << 8) | ((crc >> 8) & 0xFF);
-        t ^= (uint8_t)(d >> 4);
-        t ^= (uint16_t)d << 3;
-        crc = t;
-    }
+    for (uint8_t i = 0; i < len; i++)
+        crc = (crc >> 8) ^ crc16_table[(crc ^ pkt[i]) & 0xFF];
     return crc;
 }
 
 /* ---- Fast data parsing ---- */
 static void parse_fast(const uint8_t *buf)
 {
-    ecu_data.runlevel = buf[2];
-
-    ecu_data.ign_angle    = read_i16(&buf[3]) * 0.25f;
-    ecu_data.fuel_flow    = buf[5] * (1.0f / 16.0f);
-
-    uint16_t period = read_u16(&buf[6]);
-    ecu_data.rpm = (period > 0) ? (10000000.0f / period) : 0.0f;
-
-    ecu_data.inj_time_ms  = read_u16(&buf[8]) * 0.004f;
-    ecu_data.knock_v      = buf[10] * (5.0f / 256.0f);
-    ecu_data.tps          = buf[11] * (100.0f / 255.0f);
-    ecu_data.dbw_pos      = buf[12] * (100.0f / 255.0f);
-    ecu_data.map_kpa      = buf[13] * 2.0f;
-    ecu_data.lambda       = buf[14] * (1.0f / 128.0f);
-    ecu_data.cyl_no       = buf[15];
-    ecu_data.transient_corr = (int8_t)buf[16];
-    ecu_data.speed        = buf[17];
+    PUT(runlevel,       buf[2],                 CONV_U);
+    PUT(ign_angle,      read_i16(&buf[3]),      CONV_QDEG);
+    PUT(fuel_flow,      buf[5],                 CONV_DIV16);
+    PUT(rpm,            read_u16(&buf[6]),      CONV_RPM);
+    PUT(inj_time_ms,    read_u16(&buf[8]),      CONV_INJ_MS);
+    PUT(knock_v,        buf[10],                CONV_KNOCK_V);
+    PUT(tps,            buf[11],                CONV_PCT255);
+    PUT(dbw_pos,        buf[12],                CONV_PCT255);
+    PUT(map_kpa,        buf[13],                CONV_X2);
+    PUT(lambda,         buf[14],                CONV_LAMBDA);
+    PUT(cyl_no,         buf[15],                CONV_U);
+    PUT(transient_corr, (int8_t)buf[16],        CONV_S);
+    PUT(speed,          buf[17],                CONV_U);
 }
 
 /* ---- Slow packet parsing ---- */
@@ -116,291 +317,459 @@ static void parse_slow(uint8_t id, const uint8_t *s)
 {
     switch (id) {
     case 0: /* corrections & electrical */
-        ecu_data.corr_angle      = (int8_t)s[0];
-        ecu_data.lambda_target   = s[1] * (1.0f / 128.0f);
-        ecu_data.lambda_corr_fast = (int8_t)s[2];
-        ecu_data.lambda_corr_slow = (int8_t)s[3];
-        ecu_data.fuel_pressure_kpa = (float)read_u16(&s[4]);
-        ecu_data.dwell_ms        = s[6];
-        ecu_data.voltage         = s[7] * 0.1f;
-        ecu_data.gear            = (int8_t)s[8];
-        ecu_data.dbw_cmd         = s[9];
-        ecu_data.lambda2         = s[10] * (1.0f / 128.0f);
+        PUT(corr_angle,          (int8_t)s[0],      CONV_S);
+        PUT(lambda_target,       s[1],              CONV_LAMBDA);
+        PUT(lambda_corr_fast,    (int8_t)s[2],      CONV_S);
+        PUT(lambda_corr_slow,    (int8_t)s[3],      CONV_S);
+        PUT(fuel_pressure_kpa,   read_u16(&s[4]),   CONV_U);
+        PUT(dwell_ms,            s[6],              CONV_U);
+        PUT(voltage,             s[7],              CONV_X0_1);
+        PUT(gear,                (int8_t)s[8],      CONV_S);
+        PUT(dbw_cmd,             s[9],              CONV_U);
+        PUT(lambda2,             s[10],             CONV_LAMBDA);
         break;
 
     case 1: /* flags & boost */
-        ecu_data.flag_major      = s[0];
-        ecu_data.flag_minor      = s[1];
-        ecu_data.flag_notify     = s[2];
-        ecu_data.flag_notify2    = s[3];
-        ecu_data.flag_protection = s[4];
-        ecu_data.idle_pos        = s[5] * (100.0f / 256.0f);
-        ecu_data.airflow         = read_u16(&s[6]);
-        ecu_data.boost_duty      = s[8];
-        ecu_data.boost_target    = s[9];
+        PUT(flag_major,          s[0],              CONV_U);
+        PUT(flag_minor,          s[1],              CONV_U);
+        PUT(flag_notify,         s[2],              CONV_U);
+        PUT(flag_notify2,        s[3],              CONV_U);
+        PUT(flag_protection,     s[4],              CONV_U);
+        PUT(idle_pos,            s[5],              CONV_PCT256);
+        PUT(airflow,             read_u16(&s[6]),   CONV_U);
+        PUT(boost_duty,          s[8],              CONV_U);
+        PUT(boost_target,        s[9],              CONV_U);
         break;
 
     case 2: /* injection details */
-        ecu_data.egr_pos         = s[0];
-        ecu_data.egr_target      = s[1];
-        ecu_data.inj_duty        = s[2];
-        ecu_data.inj_lag_time    = read_i16(&s[3]);
-        ecu_data.inj_end_angle   = (int8_t)s[5];
-        ecu_data.fuel_press_coef = s[6];
-        ecu_data.air_charge_t    = (int8_t)s[7];
-        ecu_data.inj_air_charge_corr = (int8_t)s[8];
-        ecu_data.speed2          = s[9];
-        ecu_data.back_pressure_kpa = s[10] * 2.0f;
+        PUT(egr_pos,             s[0],              CONV_U);
+        PUT(egr_target,          s[1],              CONV_U);
+        PUT(inj_duty,            s[2],              CONV_U);
+        PUT(inj_lag_time,        read_i16(&s[3]),   CONV_S);
+        PUT(inj_end_angle,       (int8_t)s[5],      CONV_S);
+        PUT(fuel_press_coef,     s[6],              CONV_U);
+        PUT(air_charge_t,        (int8_t)s[7],      CONV_S);
+        PUT(inj_air_charge_corr, (int8_t)s[8],      CONV_S);
+        PUT(speed2,              s[9],              CONV_U);
+        PUT(back_pressure_kpa,   s[10],             CONV_X2);
         break;
 
     case 3: /* VVT & traction */
-        ecu_data.ign_accel_corr  = read_i16(&s[0]);
-        ecu_data.vvt1_curr       = (int8_t)s[2];
-        ecu_data.vvt1_target     = (int8_t)s[3];
-        ecu_data.vvt2_curr       = (int8_t)s[4];
-        ecu_data.vvt2_target     = (int8_t)s[5];
-        ecu_data.vvt1b_curr      = (int8_t)s[6];
-        ecu_data.vvt2b_curr      = (int8_t)s[7];
-        ecu_data.tcs_corr        = s[8];
-        ecu_data.pwm3d_target    = s[9] * (100.0f / 256.0f);
-        ecu_data.pwm3d_curr      = s[10] * (100.0f / 256.0f);
+        PUT(ign_accel_corr,      read_i16(&s[0]),   CONV_S);
+        PUT(vvt1_curr,           (int8_t)s[2],      CONV_S);
+        PUT(vvt1_target,         (int8_t)s[3],      CONV_S);
+        PUT(vvt2_curr,           (int8_t)s[4],      CONV_S);
+        PUT(vvt2_target,         (int8_t)s[5],      CONV_S);
+        PUT(vvt1b_curr,          (int8_t)s[6],      CONV_S);
+        PUT(vvt2b_curr,          (int8_t)s[7],      CONV_S);
+        PUT(tcs_corr,            s[8],              CONV_U);
+        PUT(pwm3d_target,        s[9],              CONV_PCT256);
+        PUT(pwm3d_curr,          s[10],             CONV_PCT256);
         break;
 
     case 4: /* trip computer */
-        ecu_data.trip_fuel_l     = read_u16(&s[0]) * 0.01f;
-        ecu_data.trip_path_km    = read_u16(&s[2]) * 0.1f;
-        ecu_data.curr_fuel_cons  = read_u16(&s[4]) * 0.1f;
-        ecu_data.trip_fuel_cons  = read_u16(&s[6]) * 0.1f;
-        ecu_data.fuel_composition = s[8] * (100.0f / 256.0f);
+        PUT(trip_fuel_l,         read_u16(&s[0]),   CONV_X0_01);
+        PUT(trip_path_km,        read_u16(&s[2]),   CONV_X0_1);
+        PUT(curr_fuel_cons,      read_u16(&s[4]),   CONV_X0_1);
+        PUT(trip_fuel_cons,      read_u16(&s[6]),   CONV_X0_1);
+        PUT(fuel_composition,    s[8],              CONV_PCT256);
         break;
 
     case 5: /* raw ADC */
-        ecu_data.adc_tps    = s[0];
-        ecu_data.adc_ct     = s[1];
-        ecu_data.adc_iat    = s[2];
-        ecu_data.adc_dbw1   = s[3];
-        ecu_data.adc_dbw2   = s[4];
-        ecu_data.adc_map    = s[5];
-        ecu_data.adc_lambda = s[6];
+        PUT(adc_tps,             s[0],              CONV_U);
+        PUT(adc_ct,              s[1],              CONV_U);
+        PUT(adc_iat,             s[2],              CONV_U);
+        PUT(adc_dbw1,            s[3],              CONV_U);
+        PUT(adc_dbw2,            s[4],              CONV_U);
+        PUT(adc_map,             s[5],              CONV_U);
+        PUT(adc_lambda,          s[6],              CONV_U);
         break;
 
     case 6: /* analog inputs ADC */
         for (int i = 0; i < 10 && i < SLOW_PACKET_SIZE; i++)
-            ecu_data.adc_an[i] = s[i];
+            put(INVENT_EMS_CH_adc_an0 + i, s[i], CONV_U);
         break;
 
     case 7: /* I/O state */
-        ecu_data.input_state       = s[0];
-        ecu_data.output_state      = read_u16(&s[1]);
-        ecu_data.dbw_driver_status = s[3];
-        ecu_data.dbw_system_status = s[4];
-        ecu_data.gas_state         = s[5];
-        ecu_data.at_temp           = (int8_t)s[6];
-        ecu_data.at_state          = s[7];
-        ecu_data.fuel_level        = s[8];
+        PUT(input_state,         s[0],              CONV_U);
+        PUT(output_state,        read_u16(&s[1]),   CONV_U);
+        PUT(dbw_driver_status,   s[3],              CONV_U);
+        PUT(dbw_system_status,   s[4],              CONV_U);
+        PUT(gas_state,           s[5],              CONV_U);
+        PUT(at_temp,             (int8_t)s[6],      CONV_S);
+        PUT(at_state,            s[7],              CONV_U);
+        PUT(fuel_level,          s[8],              CONV_U);
         break;
 
     case 8: /* temperatures & pressures */
-        ecu_data.clt          = (int8_t)s[0];
-        ecu_data.iat          = (int8_t)s[1];
-        ecu_data.oil_temp     = s[2];
-        ecu_data.fuel_temp    = (int8_t)s[3];
+        PUT(clt,                 (int8_t)s[0],      CONV_S);
+        PUT(iat,                 (int8_t)s[1],      CONV_S);
+        PUT(oil_temp,            s[2],              CONV_U);
+        PUT(fuel_temp,           (int8_t)s[3],      CONV_S);
         /* s[4] = _free */
-        ecu_data.egt1         = (float)read_u16(&s[5]);
-        ecu_data.egt2         = (float)read_u16(&s[7]);
-        ecu_data.oil_pressure = s[9] * 0.1f;
+        PUT(egt1,                read_u16(&s[5]),   CONV_U);
+        PUT(egt2,                read_u16(&s[7]),   CONV_U);
+        PUT(oil_pressure,        s[9],              CONV_X0_1);
         break;
 
     case 9: /* PWM duties */
         for (int i = 0; i < 6; i++)
-            ecu_data.pwm_duty[i] = s[i] * (100.0f / 256.0f);
+            put(INVENT_EMS_CH_pwm_duty0 + i, s[i], CONV_PCT256);
         break;
     }
 }
 
-/* ---- Full packet parsing ---- */
-static void parse_packet(void)
+static void parse_packet(const uint8_t *pkt)
 {
-    parse_fast(rxbuf);
+    /* Short packets are parsed from a zero-padded copy so the fixed
+     * TInfoPacket offsets never read past the end of the frame. */
+    uint8_t padded[INFO_PACKET_LEN + 1];
+    if (pkt[0] < INFO_PACKET_LEN) {
+        memset(padded, 0, sizeof(padded));
+        memcpy(padded, pkt, pkt[0] + 1u);
+        pkt = padded;
+    }
+
+    parse_fast(pkt);
 
-    uint8_t slow_id = rxbuf[24];
+    uint8_t slow_id = pkt[24];
     if (slow_id < SLOW_PACKET_COUNT) {
-        parse_slow(slow_id, &rxbuf[SLOW_PACKET_OFFSET]);
+        parse_slow(slow_id, &pkt[SLOW_PACKET_OFFSET]);
     }
 
     ecu_data.connected = true;
     ecu_data.packet_count++;
-    new_data_flag = true;
+    pending = true;
+}
+
+/*
+ * Scan buf for complete frames, validate and parse each one in place.
+ * Returns the number of bytes consumed; the unconsumed tail (< one
+ * frame) is the start of a frame that has not fully arrived yet.
+ */
+static size_t scan_frames(const uint8_t *buf, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len) {
+        const uint8_t *sync = memchr(&buf[i], HEADER_0, len - i);
+        if (sync == NULL)
+            return len;
+        i = (size_t)(sync - buf);
+
+        size_t avail = len - i;
+        if (avail <= HEADER_LEN) {
+            /* Truncated header — keep it only if it still matches */
+            if (memcmp(&buf[i], header, avail) == 0)
+                return i;
+            i++;
+            continue;
+        }
+        if (memcmp(&buf[i], header, HEADER_LEN) != 0) {
+            i++;
+            continue;
+        }
+
+        const uint8_t *pkt = &buf[i + HEADER_LEN];
+        if (pkt[0] < MIN_PACKET_LEN || pkt[0] > MAX_PACKET_LEN) {
+            i++;
+            continue;
+        }
+
+        size_t frame_len = HEADER_LEN + 1 + pkt[0];
+        if (avail < frame_len)
+            return i;
+
+        uint16_t crc_rx = read_u16(&pkt[pkt[0] - 1]);
+        if (checksum(pkt) == crc_rx) {
+            parse_packet(pkt);
+            i += frame_len;
+        } else {
+            ecu_data.error_count++;
+            pending = true;
+            i++;                    /* resync from the next byte */
+        }
+    }
+    return i;
+}
+
+/*
+ * Build can_conv[] for a set of CAN tables, appending their scale/offset
+ * pairs to convs[] (shared pairs are stored once).  On overflow nothing
+ * is changed and false is returned.
+ */
+static bool register_can_convs(const can_dbc_t *db)
+{
+    uint8_t count = CONV_BUILTIN_COUNT;
+    uint8_t map[INVENT_EMS_CH_COUNT];
+    conv_t  added[CONV_MAX - CONV_BUILTIN_COUNT];
+
+    memset(map, CONV_NONE, sizeof(map));
+    for (uint16_t i = 0; i < db->signal_count; i++) {
+        const can_dbc_signal_t *s = &db->signals[i];
+        conv_t c = {
+            s->scale, s->offset,
+            (s->flags & CAN_DBC_SIGNED) ? KIND_SIGNED : KIND_UNSIGNED
+        };
+
+        uint8_t k = CONV_BUILTIN_COUNT;
+        while (k < count) {
+            const conv_t *e = &added[k - CONV_BUILTIN_COUNT];
+            if (e->scale == c.scale && e->offset == c.offset &&
+                e->kind == c.kind)
+                break;
+            k++;
+        }
+        if (k == count) {
+            if (count == CONV_MAX)
+                return false;
+            added[count++ - CONV_BUILTIN_COUNT] = c;
+        }
+        if (s->channel < INVENT_EMS_CH_COUNT)
+            map[s->channel] = k;
+    }
+
+    memcpy(&convs[CONV_BUILTIN_COUNT], added,
+           (count - CONV_BUILTIN_COUNT) * sizeof(conv_t));
+    memcpy(can_conv, map, sizeof(can_conv));
+    return true;
 }
 
 /* ---- Public API ---- */
 
 void invent_ems_init(void)
 {
+    /* seen[] clear: every channel reads NaN until it arrives */
     memset(&ecu_data, 0, sizeof(ecu_data));
-
-    /* All floats start as NaN — "no data yet" */
-    ecu_data.rpm = NAN;
-    ecu_data.ign_angle = NAN;
-    ecu_data.inj_time_ms = NAN;
-    ecu_data.tps = NAN;
-    ecu_data.dbw_pos = NAN;
-    ecu_data.map_kpa = NAN;
-    ecu_data.lambda = NAN;
-    ecu_data.speed = NAN;
-    ecu_data.fuel_flow = NAN;
-    ecu_data.knock_v = NAN;
-
-    ecu_data.lambda_target = NAN;
-    ecu_data.fuel_pressure_kpa = NAN;
-    ecu_data.dwell_ms = NAN;
-    ecu_data.voltage = NAN;
-    ecu_data.dbw_cmd = NAN;
-    ecu_data.lambda2 = NAN;
-
-    ecu_data.idle_pos = NAN;
-    ecu_data.back_pressure_kpa = NAN;
-
-    ecu_data.pwm3d_target = NAN;
-    ecu_data.pwm3d_curr = NAN;
-
-    ecu_data.trip_fuel_l = NAN;
-    ecu_data.trip_path_km = NAN;
-    ecu_data.curr_fuel_cons = NAN;
-    ecu_data.trip_fuel_cons = NAN;
-    ecu_data.fuel_composition = NAN;
-
-    ecu_data.clt = NAN;
-    ecu_data.iat = NAN;
-    ecu_data.oil_temp = NAN;
-    ecu_data.fuel_temp = NAN;
-    ecu_data.egt1 = NAN;
-    ecu_data.egt2 = NAN;
-    ecu_data.oil_pressure = NAN;
-
-    for (int i = 0; i < 6; i++)
-        ecu_data.pwm_duty[i] = NAN;
-
-    rxstate = 0;
-    rxptr = 0;
-    new_data_flag = false;
+    memset(chan_gen, 0, sizeof(chan_gen));
+    memset(chan_us, 0, sizeof(chan_us));
+
+    carry_len = 0;
+    pending = false;
+    memset(touched, 0, sizeof(touched));
+    memset(preferred, INVENT_EMS_SRC_UART, sizeof(preferred));
+    memset(preferred_us, 0, sizeof(preferred_us));
+    clock_us = 0;
+    update_can_accept();
+
+    for (int i = 0; i < 3; i++)
+        snap[i] = ecu_data;
+    front = 0;
+    atomic_store(&middle, 1);
+    back = 2;
+    last = 1;
+
+    register_can_convs(can_db);
+    atomic_store(&publish_count, 0);
+    atomic_store(&consume_count, 0);
 }
 
 void invent_ems_feed_byte(uint8_t byte)
 {
-    bool retry;
-    do {
-        retry = false;
-        switch (rxstate) {
-        case 0:
-            if (byte == HEADER_0) rxstate++;
-            break;
-        case 1:
-            if (byte == HEADER_1) rxstate++;
-            else { rxstate = 0; retry = true; }
-            break;
-        case 2:
-            if (byte == HEADER_2) rxstate++;
-            else { rxstate = 0; retry = true; }
-            break;
-        case 3:
-            if (byte == HEADER_3) rxstate++;
-            else { rxstate = 0; retry = true; }
-            break;
-        case 4: /* protocol version */
-            if (byte == INVENT_EMS_PROTOCOL_VER) rxstate++;
-            else { rxstate = 0; retry = true; }
-            break;
-        case 5: /* length byte */
-            if (byte >= MIN_PACKET_LEN && byte <= MAX_PACKET_LEN) {
-                rxbuf[0] = byte;
-                rxptr = 1;
-                rxstate++;
-            } else {
-                rxstate = 0;
-            }
-            break;
-        case 6: /* payload + CRC */
-            if (rxptr < MAX_RX_BUF) {
-                rxbuf[rxptr] = byte;
-            }
-            rxptr++;
-            if (rxptr > rxbuf[0]) {
-                /* Full packet received — verify CRC */
-                uint16_t crc_rx   = (uint16_t)rxbuf[rxptr - 2]
-                                  | ((uint16_t)rxbuf[rxptr - 1] << 8);
-                uint16_t crc_calc = checksum(rxbuf);
-                if (crc_calc == crc_rx) {
-                    parse_packet();
-                } else {
-                    ecu_data.error_count++;
-                }
-                rxstate = 0;
-            }
-            break;
-        default:
-            rxstate = 0;
+    invent_ems_feed_bytes(&byte, 1);
+}
+
+void invent_ems_feed_bytes(const uint8_t *data, size_t len)
+{
+    if (carry_len > 0) {
+        /* Top up the carried prefix and parse it first */
+        size_t old  = carry_len;
+        size_t take = sizeof(carry) - carry_len;
+        if (take > len) take = len;
+        memcpy(&carry[carry_len], data, take);
+        carry_len += take;
+
+        size_t used = scan_frames(carry, carry_len);
+        if (used < old) {
+            /* Still waiting for the rest of a frame; all input absorbed */
+            memmove(carry, &carry[used], carry_len - used);
+            carry_len -= used;
+            return;
         }
-    } while (retry);
+        /* The carried bytes are done — resume directly in the input */
+        carry_len = 0;
+        data += used - old;
+        len  -= used - old;
+    }
+
+    size_t used = scan_frames(data, len);
+    carry_len = len - used;
+    memcpy(carry, &data[used], carry_len);
 }
 
-const invent_ems_data_t *invent_ems_get_data(void)
+uint32_t invent_ems_publish(uint32_t now_us)
 {
-    return &ecu_data;
+    clock_us = now_us;
+    update_can_accept();
+    if (!pending)
+        return 0;
+    pending = false;
+
+    /* Stamp the sampled channels; bump the generation of those whose
+     * value differs from the previous publish.  snap[last] is never the
+     * back buffer, and the consumer only reads it, so this is safe. */
+    uint32_t gen = ++ecu_data.generation;
+    const invent_ems_data_t *prev = &snap[last];
+    if (now_us == 0)
+        now_us = 1;                         /* 0 means "never sampled" */
+
+    for (unsigned w = 0; w < INVENT_EMS_CH_WORDS; w++) {
+        uint32_t bits = touched[w];
+        touched[w] = 0;
+        while (bits) {
+            unsigned ch = w * 32 + (unsigned)__builtin_ctz(bits);
+            bits &= bits - 1;
+
+            chan_us[ch] = now_us;
+            if (ecu_data.raw[ch] != prev->raw[ch] ||
+                bit_get(ecu_data.seen, ch) != bit_get(prev->seen, ch) ||
+                bit_get(ecu_data.from_can, ch) != bit_get(prev->from_can, ch))
+                chan_gen[ch] = gen;
+        }
+    }
+
+    snap[back] = ecu_data;
+    last = back;
+    /* seq_cst exchange: the copy above is visible before the index is */
+    uint8_t old = atomic_exchange(&middle, (uint8_t)(back | SNAP_FRESH));
+    back = old & SNAP_INDEX;
+    atomic_fetch_add_explicit(&publish_count, 1, memory_order_relaxed);
+    return gen;
 }
 
-/* ---- CAN DBC decode (matches InventEmu TX encoding) ---- */
-bool invent_ems_feed_can_frame(uint32_t id, const uint8_t *d, uint8_t dlc)
+bool invent_ems_acquire(void)
 {
-    (void)dlc;
-    switch (id) {
-    case 0x300: /* RPM, TPS, MAP, IAT */
-        ecu_data.rpm     = (float)read_u16(&d[0]);
-        ecu_data.tps     = read_i16(&d[2]) * 0.1f;
-        ecu_data.map_kpa = read_u16(&d[4]) * 0.01f;
-        ecu_data.iat     = read_i16(&d[6]) * 0.1f;
-        break;
-    case 0x302: /* IgnAngle, Dwell, InjAngle, InjPW */
-        ecu_data.ign_angle   = read_i16(&d[0]) * 0.1f;
-        ecu_data.dwell_ms    = read_u16(&d[2]) * 0.1f;
-        ecu_data.inj_time_ms = read_u16(&d[6]) * 0.001f;
-        break;
-    case 0x304: /* OilT, OilP, CLT, VBAT */
-        ecu_data.oil_temp     = read_i16(&d[0]) * 0.1f;
-        ecu_data.oil_pressure = read_i16(&d[2]) * 0.1f / 100.0f;
-        ecu_data.clt          = read_i16(&d[4]) * 0.1f;
-        ecu_data.voltage      = read_i16(&d[6]) * 0.1f;
-        break;
-    case 0x305: /* Gear, MapTarget, Speed, EvtMask */
-        ecu_data.gear  = (int8_t)read_i16(&d[0]);
-        ecu_data.speed = read_u16(&d[4]) * 0.1f;
-        break;
-    case 0x306: /* Knock1, Knock2, FuelP, FuelT */
-        ecu_data.knock_v           = read_i16(&d[0]) * 0.1f;
-        ecu_data.fuel_pressure_kpa = read_u16(&d[4]) * 0.1f;
-        ecu_data.fuel_temp         = read_i16(&d[6]) * 0.1f;
-        break;
-    case 0x307: /* EGT1, EGT2 */
-        ecu_data.egt1 = read_i16(&d[0]) * 0.1f;
-        ecu_data.egt2 = read_i16(&d[2]) * 0.1f;
-        break;
-    case 0x340: /* Vehicle speed */
-        ecu_data.speed = read_u16(&d[0]) * 0.1f;
-        break;
-    default:
+    if (!invent_ems_available())
         return false;
-    }
 
-    ecu_data.connected = true;
-    new_data_flag = true;
+    uint8_t prev = atomic_exchange(&middle, front);
+    front = prev & SNAP_INDEX;
+    atomic_fetch_add_explicit(&consume_count, 1, memory_order_relaxed);
     return true;
 }
 
-bool invent_ems_has_new_data(void)
+bool invent_ems_available(void)
 {
-    if (new_data_flag) {
-        new_data_flag = false;
-        return true;
+    return (atomic_load(&middle) & SNAP_FRESH) != 0;
+}
+
+const invent_ems_data_t *invent_ems_get_data(void)
+{
+    return &snap[front];
+}
+
+invent_ems_snapshot_stats_t invent_ems_get_snapshot_stats(void)
+{
+    invent_ems_snapshot_stats_t st;
+    st.consumed  = atomic_load_explicit(&consume_count, memory_order_relaxed);
+    st.published = atomic_load_explicit(&publish_count, memory_order_relaxed);
+    return st;
+}
+
+bool invent_ems_changed(invent_ems_channel_t ch, uint32_t since_gen)
+{
+    return chan_gen[ch] > since_gen;
+}
+
+uint32_t invent_ems_age_us(invent_ems_channel_t ch, uint32_t now_us)
+{
+    uint32_t t = chan_us[ch];
+    return t ? now_us - t : UINT32_MAX;
+}
+
+size_t invent_ems_changed_since(uint32_t since_gen,
+                                uint32_t mask[INVENT_EMS_CH_WORDS])
+{
+    size_t n = 0;
+    memset(mask, 0, INVENT_EMS_CH_WORDS * sizeof(mask[0]));
+    for (unsigned ch = 0; ch < INVENT_EMS_CH_COUNT; ch++) {
+        if (chan_gen[ch] > since_gen) {
+            mask[ch >> 5] |= 1u << (ch & 31);
+            n++;
+        }
+    }
+    return n;
+}
+
+float invent_ems_value(const invent_ems_data_t *d, invent_ems_channel_t ch)
+{
+    if (!bit_get(d->seen, ch))
+        return NAN;
+    const conv_t *c = &convs[bit_get(d->from_can, ch) ? can_conv[ch]
+                                                      : uart_conv[ch]];
+    uint16_t raw = d->raw[ch];
+
+    switch (c->kind) {
+    case KIND_UNSIGNED:   return raw * c->scale + c->offset;
+    case KIND_SIGNED:     return (int16_t)raw * c->scale + c->offset;
+    case KIND_RECIPROCAL: return raw ? c->scale / raw : 0.0f;
+    default:              return NAN;
+    }
+}
+
+const char *invent_ems_channel_name(invent_ems_channel_t ch)
+{
+    return channel_names[ch];
+}
+
+/* ---- CAN decode (tables generated from ME442/ME1_4.dbc) ---- */
+bool invent_ems_resolve_channel(const char *name, uint8_t *channel)
+{
+    for (unsigned i = 0; i < INVENT_EMS_CH_COUNT; i++) {
+        if (strcmp(channel_names[i], name) == 0) {
+            *channel = (uint8_t)i;
+            return true;
+        }
     }
     return false;
 }
+
+void invent_ems_set_preferred(invent_ems_channel_t ch, invent_ems_source_t src)
+{
+    if ((unsigned)ch < INVENT_EMS_CH_COUNT && src < INVENT_EMS_SRC_COUNT) {
+        preferred[ch] = (uint8_t)src;
+        update_can_accept();
+    }
+}
+
+bool invent_ems_set_can_dbc(const can_dbc_t *db)
+{
+    if (db == NULL)
+        db = &can_dbc_me442;
+    if (!register_can_convs(db))
+        return false;
+    can_db = db;
+    return true;
+}
+
+const can_dbc_t *invent_ems_get_can_dbc(void)
+{
+    return can_db;
+}
+
+bool invent_ems_feed_can_frame(uint32_t id, const uint8_t *d, uint8_t dlc)
+{
+    /* Signals land in the working copy directly; channels the CAN
+     * source may not overwrite now are skipped during extraction */
+    uint32_t updated[INVENT_EMS_CH_WORDS] = {0};
+    if (!can_dbc_decode(can_db, id, d, dlc, ecu_data.raw, can_accept,
+                        updated))
+        return false;
+
+    for (unsigned w = 0; w < INVENT_EMS_CH_WORDS; w++) {
+        uint32_t bits = updated[w];
+        ecu_data.seen[w]     |= bits;
+        ecu_data.from_can[w] |= bits;
+        touched[w]           |= bits;
+        while (bits) {
+            unsigned ch = w * 32 + (unsigned)__builtin_ctz(bits);
+            bits &= bits - 1;
+            if (preferred[ch] == INVENT_EMS_SRC_CAN)
+                preferred_us[ch] = clock_us | 1;
+        }
+    }
+
+    ecu_data.connected = true;
+    pending = true;
+    return true;
+}
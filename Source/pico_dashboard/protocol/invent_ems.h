@@ -8,6 +8,7 @@ extern "C" {
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include "can_dbc.h"
 
 /*
  * Invent Labs EMS Dashboard Protocol parser
@@ -22,132 +23,204 @@ extern "C" {
 #define INVENT_EMS_BAUD_RATE      19200
 #define INVENT_EMS_PROTOCOL_VER   0x54
 
-/* Accumulated ECU data with engineering-unit conversions */
+/*
+ * Channel list — every value the ECU reports, grouped by the packet that
+ * carries it on the Invent UART link.  X(name) for scalars, XI(name, i)
+ * for array elements.  Channel IDs (INVENT_EMS_CH_<name>, array elements
+ * as e.g. INVENT_EMS_CH_adc_an3) index the arrays of invent_ems_data_t
+ * and are the targets of the CAN decode tables.
+ */
+#define INVENT_EMS_CHANNELS(X, XI)                                          \
+    /* Fast data (every packet, ~50 Hz) */                                  \
+    X(rpm) X(ign_angle) X(inj_time_ms) X(tps) X(dbw_pos) X(map_kpa)         \
+    X(lambda) X(speed) X(fuel_flow) X(knock_v) X(transient_corr)            \
+    X(runlevel) X(cyl_no)                                                   \
+    /* Slow0: corrections & electrical */                                   \
+    X(corr_angle) X(lambda_target) X(lambda_corr_fast) X(lambda_corr_slow)  \
+    X(fuel_pressure_kpa) X(dwell_ms) X(voltage) X(gear) X(dbw_cmd)          \
+    X(lambda2)                                                              \
+    /* Slow1: flags & boost */                                              \
+    X(flag_major) X(flag_minor) X(flag_notify) X(flag_notify2)              \
+    X(flag_protection) X(idle_pos) X(airflow) X(boost_duty)                 \
+    X(boost_target)                                                         \
+    /* Slow2: injection details */                                          \
+    X(egr_pos) X(egr_target) X(inj_duty) X(inj_lag_time) X(inj_end_angle)   \
+    X(fuel_press_coef) X(air_charge_t) X(inj_air_charge_corr) X(speed2)     \
+    X(back_pressure_kpa)                                                    \
+    /* Slow3: VVT & traction */                                             \
+    X(ign_accel_corr) X(vvt1_curr) X(vvt1_target) X(vvt2_curr)              \
+    X(vvt2_target) X(vvt1b_curr) X(vvt2b_curr) X(tcs_corr)                  \
+    X(pwm3d_target) X(pwm3d_curr)                                           \
+    /* Slow4: trip computer */                                              \
+    X(trip_fuel_l) X(trip_path_km) X(curr_fuel_cons) X(trip_fuel_cons)      \
+    X(fuel_composition)                                                     \
+    /* Slow5: raw ADC */                                                    \
+    X(adc_tps) X(adc_ct) X(adc_iat) X(adc_dbw1) X(adc_dbw2) X(adc_map)      \
+    X(adc_lambda)                                                           \
+    /* Slow6: analog inputs ADC */                                          \
+    XI(adc_an, 0) XI(adc_an, 1) XI(adc_an, 2) XI(adc_an, 3) XI(adc_an, 4)   \
+    XI(adc_an, 5) XI(adc_an, 6) XI(adc_an, 7) XI(adc_an, 8) XI(adc_an, 9)   \
+    /* Slow7: I/O state */                                                  \
+    X(input_state) X(output_state) X(dbw_driver_status)                     \
+    X(dbw_system_status) X(gas_state) X(at_temp) X(at_state) X(fuel_level)  \
+    /* Slow8: temperatures & pressures */                                   \
+    X(clt) X(iat) X(oil_temp) X(fuel_temp) X(egt1) X(egt2) X(oil_pressure)  \
+    /* Slow9: PWM outputs */                                                \
+    XI(pwm_duty, 0) XI(pwm_duty, 1) XI(pwm_duty, 2) XI(pwm_duty, 3)         \
+    XI(pwm_duty, 4) XI(pwm_duty, 5)                                         \
+    /* ME442 CAN only (see protocol/me442_signals.map) */                   \
+    X(rpm_limit) X(afr) X(afr2) X(afr_target) X(lambda_trim) X(inj_angle)   \
+    X(inj2_time_ms) X(inj2_duty) X(inj2_angle) X(map_target_kpa)            \
+    X(eps_event_mask) X(knock_peak) X(knock_retard) X(knock_count)          \
+    X(gpt1) X(gpt2)
+
+#define INVENT_EMS_CH_ENUM_(f)          INVENT_EMS_CH_##f,
+#define INVENT_EMS_CH_ENUM_IDX_(f, i)   INVENT_EMS_CH_##f##i,
+
+typedef enum {
+    INVENT_EMS_CHANNELS(INVENT_EMS_CH_ENUM_, INVENT_EMS_CH_ENUM_IDX_)
+    INVENT_EMS_CH_COUNT
+} invent_ems_channel_t;
+
+#define INVENT_EMS_CH_WORDS   ((INVENT_EMS_CH_COUNT + 31) / 32)
+
+/*
+ * Accumulated ECU data.  Channels are kept as the raw integers received
+ * on the wire (every source is at most 16 bits wide; signed values are
+ * stored sign-extended).  The conversion to engineering units depends
+ * only on the channel and the source that delivered it, so it lives in
+ * per-channel tables inside invent_ems.c; the snapshot only records the
+ * source.  Nothing is converted until a consumer asks, through
+ * invent_ems_value().
+ *
+ * raw[] and the two masks are the whole per-channel record: 2 bytes per
+ * channel plus 2 bits.
+ */
 typedef struct {
     /* Connection status */
     bool connected;
     uint32_t packet_count;
     uint32_t error_count;
+    uint32_t generation;                        /* publish number of this snapshot */
 
-    /* ---- Fast data (updated every packet ~50 Hz) ---- */
-    float rpm;
-    float ign_angle;        /* degrees, 0.25 resolution */
-    float inj_time_ms;      /* injector pulse width */
-    float tps;              /* throttle position 0-100 % */
-    float dbw_pos;          /* electronic throttle actual 0-100 % */
-    float map_kpa;          /* manifold pressure */
-    float lambda;           /* wideband lambda */
-    float speed;            /* vehicle speed km/h */
-    float fuel_flow;        /* instantaneous fuel flow (1/16 units) */
-    float knock_v;          /* knock sensor voltage */
-    int8_t transient_corr;  /* transient fuel correction */
-    uint8_t runlevel;
-    uint8_t cyl_no;
-
-    /* ---- Slow0: corrections & electrical ---- */
-    int8_t corr_angle;
-    float lambda_target;
-    int8_t lambda_corr_fast;
-    int8_t lambda_corr_slow;
-    float fuel_pressure_kpa;
-    float dwell_ms;
-    float voltage;          /* battery voltage V */
-    int8_t gear;
-    float dbw_cmd;          /* DBW commanded position */
-    float lambda2;
-
-    /* ---- Slow1: flags & boost ---- */
-    uint8_t flag_major;
-    uint8_t flag_minor;
-    uint8_t flag_notify;
-    uint8_t flag_notify2;
-    uint8_t flag_protection;
-    float idle_pos;         /* idle valve 0-100 % */
-    uint16_t airflow;
-    uint8_t boost_duty;
-    uint8_t boost_target;
-
-    /* ---- Slow2: injection details ---- */
-    uint8_t egr_pos;
-    uint8_t egr_target;
-    uint8_t inj_duty;       /* injection duty cycle % */
-    int16_t inj_lag_time;
-    int8_t inj_end_angle;
-    uint8_t fuel_press_coef;
-    int8_t air_charge_t;
-    int8_t inj_air_charge_corr;
-    uint8_t speed2;
-    float back_pressure_kpa;
-
-    /* ---- Slow3: VVT & traction ---- */
-    int16_t ign_accel_corr;
-    int8_t vvt1_curr;
-    int8_t vvt1_target;
-    int8_t vvt2_curr;
-    int8_t vvt2_target;
-    int8_t vvt1b_curr;
-    int8_t vvt2b_curr;
-    uint8_t tcs_corr;
-    float pwm3d_target;
-    float pwm3d_curr;
-
-    /* ---- Slow4: trip computer ---- */
-    float trip_fuel_l;       /* 0.01 L resolution */
-    float trip_path_km;      /* 0.1 km resolution */
-    float curr_fuel_cons;    /* L/100km */
-    float trip_fuel_cons;    /* L/100km */
-    float fuel_composition;  /* ethanol % */
-
-    /* ---- Slow5: raw ADC ---- */
-    uint8_t adc_tps;
-    uint8_t adc_ct;
-    uint8_t adc_iat;
-    uint8_t adc_dbw1;
-    uint8_t adc_dbw2;
-    uint8_t adc_map;
-    uint8_t adc_lambda;
-
-    /* ---- Slow6: analog inputs ADC ---- */
-    uint8_t adc_an[10];
-
-    /* ---- Slow7: I/O state ---- */
-    uint8_t input_state;
-    uint16_t output_state;
-    uint8_t dbw_driver_status;
-    uint8_t dbw_system_status;
-    uint8_t gas_state;
-    int8_t at_temp;
-    uint8_t at_state;
-    uint8_t fuel_level;
-
-    /* ---- Slow8: temperatures & pressures (KEY for dashboard) ---- */
-    float clt;              /* coolant temp C */
-    float iat;              /* intake air temp C */
-    float oil_temp;         /* oil temp C */
-    float fuel_temp;        /* fuel temp C */
-    float egt1;             /* exhaust gas temp 1 */
-    float egt2;             /* exhaust gas temp 2 */
-    float oil_pressure;     /* bar (0.1 resolution) */
-
-    /* ---- Slow9: PWM outputs ---- */
-    float pwm_duty[6];     /* PWM channels 1-6, 0-100 % */
-
+    uint16_t raw[INVENT_EMS_CH_COUNT];          /* wire value */
+    uint32_t seen[INVENT_EMS_CH_WORDS];         /* bit per channel: has data */
+    uint32_t from_can[INVENT_EMS_CH_WORDS];     /* bit per channel: value came over CAN */
 } invent_ems_data_t;
 
 /* Initialize the parser (call once at startup) */
 void invent_ems_init(void);
 
-/* Feed one byte from UART into the parser state machine */
+/* Feed one byte from UART into the parser (wrapper around feed_bytes) */
 void invent_ems_feed_byte(uint8_t byte);
 
-/* Get pointer to the latest accumulated ECU data (always valid) */
+/* Feed a block of UART bytes.  Frames are located by bulk header scan and
+ * parsed in place; a trailing partial frame is kept for the next call. */
+void invent_ems_feed_bytes(const uint8_t *data, size_t len);
+
+/*
+ * Cross-core hand-off.  The parser and the CAN decoder accumulate into a
+ * private working copy; the producer calls invent_ems_publish() after
+ * draining its input to make that state visible as one consistent
+ * snapshot.  The consumer calls invent_ems_acquire() to pick up the
+ * newest snapshot, then reads it through invent_ems_get_data().  Both
+ * sides are lock-free and never wait (triple buffer, one atomic exchange
+ * per hand-off).
+ *
+ * There is exactly one producer context and one consumer context.
+ */
+
+/* Publish the working copy if anything arrived since the last publish.
+ * `now_us` (e.g. time_us_32()) stamps every channel sampled since then;
+ * channels whose value differs from the previous publish get the new
+ * generation number.  Returns the generation of the snapshot handed
+ * over, or 0 if there was nothing to publish. */
+uint32_t invent_ems_publish(uint32_t now_us);
+
+/* Take the newest published snapshot.  Returns false if nothing new has
+ * been published since the last acquire (the current snapshot stays). */
+bool invent_ems_acquire(void);
+
+/* True if invent_ems_acquire() would pick up a new snapshot */
+bool invent_ems_available(void);
+
+/* Consumer's current snapshot (always valid, stable until the next
+ * invent_ems_acquire() on the same core) */
 const invent_ems_data_t *invent_ems_get_data(void);
 
-/* Feed one CAN frame (DBC decode into ECU data). Returns true if ID was recognized. */
+/* Hand-off counters: published - consumed = snapshots the UI skipped */
+typedef struct {
+    uint32_t published;
+    uint32_t consumed;
+} invent_ems_snapshot_stats_t;
+
+invent_ems_snapshot_stats_t invent_ems_get_snapshot_stats(void);
+
+/* ---- Per-channel change and sample tracking ----
+ *
+ * Kept outside the snapshots (invent_ems_publish() updates one shared
+ * copy) so they are not copied with every publish.  They may run one
+ * publish ahead of the consumer's snapshot; both queries then err on
+ * the safe side: a change is reported again for the next snapshot, and
+ * a channel looks fresh at most one publish early.
+ */
+
+/* True if `ch` changed value after generation `since_gen` (pass the
+ * `generation` of the last snapshot the caller rendered; 0 = ever) */
+bool invent_ems_changed(invent_ems_channel_t ch, uint32_t since_gen);
+
+/* Microseconds since `ch` was last sampled, UINT32_MAX if never */
+uint32_t invent_ems_age_us(invent_ems_channel_t ch, uint32_t now_us);
+
+/* Set one bit per channel changed after `since_gen`; returns the count */
+size_t invent_ems_changed_since(uint32_t since_gen,
+                                uint32_t mask[INVENT_EMS_CH_WORDS]);
+
+/* Channel in engineering units; NaN until the channel has been received */
+float invent_ems_value(const invent_ems_data_t *d, invent_ems_channel_t ch);
+
+/* Channel name as in INVENT_EMS_CHANNELS() (e.g. "oil_temp", "adc_an3") */
+const char *invent_ems_channel_name(invent_ems_channel_t ch);
+
+/* Feed one CAN frame (decoded via the tables generated from ME442/ME1_4.dbc).
+ * Returns true if ID was recognized. */
 bool invent_ems_feed_can_frame(uint32_t id, const uint8_t *data, uint8_t dlc);
 
-/* Returns true once after each successfully parsed packet (auto-clears) */
-bool invent_ems_has_new_data(void);
+/* ---- Input sources ----
+ *
+ * Every channel has a preferred source.  A sample from the preferred
+ * source is always taken; a sample from any other source is taken only
+ * while the preferred one has not delivered that channel for
+ * INVENT_EMS_FAILOVER_MS (or never has).  Time is that of the last
+ * invent_ems_publish().
+ */
+typedef enum {
+    INVENT_EMS_SRC_UART = 0,    /* Invent EMS dashboard protocol */
+    INVENT_EMS_SRC_CAN,         /* ME442 CAN, DBC tables */
+    INVENT_EMS_SRC_COUNT
+} invent_ems_source_t;
+
+#ifndef INVENT_EMS_FAILOVER_MS
+#define INVENT_EMS_FAILOVER_MS  500
+#endif
+
+/* Set the preferred source of a channel (default: UART).  Call before
+ * the producer starts. */
+void invent_ems_set_preferred(invent_ems_channel_t ch, invent_ems_source_t src);
+
+/*
+ * Replace the CAN decode tables (e.g. loaded from SD via can_dbc_load()).
+ * NULL restores the built-in ME442 tables.  Call before core 1 starts
+ * feeding frames.  Returns false if the tables need more distinct
+ * scale/offset pairs than the conversion table holds (nothing changes).
+ */
+bool invent_ems_set_can_dbc(const can_dbc_t *db);
+
+/* CAN decode tables in use */
+const can_dbc_t *invent_ems_get_can_dbc(void);
+
+/* can_dbc_resolve_cb_t: channel ID by name (e.g. "adc_an3") */
+bool invent_ems_resolve_channel(const char *name, uint8_t *channel);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,135 @@
+/**
+ * exec.c — cooperative deadline executive for core 1
+ *
+ * All times are time_us_32() and compared by signed difference, so the
+ * 71 minute wrap is harmless.
+ */
+
+#include "exec.h"
+#include <stddef.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+static exec_task_t      *tasks[EXEC_MAX_TASKS];
+static uint8_t           task_count;
+static volatile uint32_t idle_us;           /* total time asleep in WFE */
+
+bool exec_add(exec_task_t *task)
+{
+    if (task_count >= EXEC_MAX_TASKS)
+        return false;
+
+    task->signalled = false;
+    task->next_us   = time_us_32() + task->period_us;
+    task->runs      = 0;
+    task->overruns  = 0;
+    task->wcet_us   = 0;
+    tasks[task_count++] = task;
+    return true;
+}
+
+void exec_signal(exec_task_t *task)
+{
+    if (!task->signalled)
+        task->signal_us = time_us_32();
+    task->signalled = true;
+    __sev();                /* also sets this core's event register */
+}
+
+void exec_set_period(exec_task_t *task, uint32_t period_us)
+{
+    task->period_us = period_us;
+    task->next_us   = time_us_32() + period_us;
+}
+
+/* Highest-priority released task and its release time; otherwise NULL
+ * and the time until the next periodic release in *wait_us */
+static exec_task_t *pick(uint32_t now, uint32_t *release, uint32_t *wait_us)
+{
+    *wait_us = UINT32_MAX;
+    for (uint8_t i = 0; i < task_count; i++) {
+        exec_task_t *t = tasks[i];
+        bool due = false;
+        if (t->period_us != 0) {
+            int32_t left = (int32_t)(t->next_us - now);
+            if (left <= 0)
+                due = true;
+            else if ((uint32_t)left < *wait_us)
+                *wait_us = (uint32_t)left;
+        }
+        if (t->signalled) {
+            *release = (due && (int32_t)(t->next_us - t->signal_us) < 0)
+                       ? t->next_us : t->signal_us;
+            return t;
+        }
+        if (due) {
+            *release = t->next_us;
+            return t;
+        }
+    }
+    return NULL;
+}
+
+void exec_run(void)
+{
+    while (true) {
+        uint32_t now = time_us_32();
+        uint32_t release, wait_us;
+        exec_task_t *t = pick(now, &release, &wait_us);
+
+        if (t == NULL) {
+            if (wait_us == UINT32_MAX)
+                __wfe();
+            else
+                best_effort_wfe_or_timeout(make_timeout_time_us(wait_us));
+            idle_us += time_us_32() - now;
+            continue;
+        }
+
+        /* Clear the release before running: a signal raised while the
+         * task runs releases it again */
+        t->signalled = false;
+        if (t->period_us != 0 && (int32_t)(t->next_us - now) <= 0) {
+            t->next_us += t->period_us;
+            if ((int32_t)(t->next_us - now) <= 0) {
+                t->overruns++;          /* a whole period behind: skip */
+                t->next_us = now + t->period_us;
+            }
+        }
+
+        t->run(t->arg);
+
+        uint32_t end = time_us_32();
+        uint32_t runtime = end - now;
+        uint32_t deadline = t->deadline_us ? t->deadline_us : t->period_us;
+
+        t->runs++;
+        if (runtime > t->wcet_us)
+            t->wcet_us = runtime;
+        if (deadline != 0 && end - release > deadline)
+            t->overruns++;
+    }
+}
+
+void exec_get_stats(exec_stats_t *out)
+{
+    static uint32_t prev_idle, prev_t;
+
+    uint32_t now  = time_us_32();
+    uint32_t idle = idle_us - prev_idle;
+    uint32_t span = now - prev_t;
+
+    /* Task runs and the scheduler itself; time asleep is idle */
+    out->load_pct = (span && idle < span)
+                    ? (uint8_t)(100 - ((uint64_t)idle * 100) / span) : 0;
+    prev_idle += idle;
+    prev_t     = now;
+
+    out->task_count = task_count;
+    for (uint8_t i = 0; i < task_count; i++) {
+        out->task[i].name     = tasks[i]->name;
+        out->task[i].runs     = tasks[i]->runs;
+        out->task[i].overruns = tasks[i]->overruns;
+        out->task[i].wcet_us  = tasks[i]->wcet_us;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef EXEC_H
+#define EXEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Cooperative deadline executive (core 1)
+ *
+ * Tasks run to completion, one at a time, in priority order (the order
+ * they were added).  After every task the scan restarts from the top,
+ * so a frequent high-priority task (CAN drain) is never held up by more
+ * than one run of a lower one.  When nothing is ready the core sleeps
+ * in WFE until the next periodic release or an exec_signal().
+ *
+ * A task is released by its period, by exec_signal() (safe from an
+ * ISR or the other core), or both.  It overruns when it completes more
+ * than `deadline_us` after its release, or when a periodic task falls
+ * a whole period behind (that release is skipped).  Per-task run count,
+ * worst-case runtime and overruns are kept for the debug console.
+ */
+
+typedef struct exec_task {
+    /* ---- Set by the owner ---- */
+    const char *name;
+    void      (*run)(void *arg);
+    void       *arg;
+    uint32_t    period_us;      /* 0 = only runs when signalled */
+    uint32_t    deadline_us;    /* release → completion; 0 = period */
+
+    /* ---- Executive state ---- */
+    volatile bool signalled;
+    uint32_t    next_us;        /* next periodic release */
+    uint32_t    signal_us;      /* first signal since last run */
+
+    /* ---- Accounting ---- */
+    uint32_t    runs;
+    uint32_t    overruns;
+    uint32_t    wcet_us;        /* worst-case runtime */
+} exec_task_t;
+
+#define EXEC_MAX_TASKS 8
+
+/* Register a task (before exec_run()).  Returns false if full. */
+bool exec_add(exec_task_t *task);
+
+/* Release a task as soon as possible; ISR- and cross-core-safe */
+void exec_signal(exec_task_t *task);
+
+/* Change a task's period from core 1 (typically its own run());
+ * the next periodic release is one new period from now */
+void exec_set_period(exec_task_t *task, uint32_t period_us);
+
+/* Run the executive forever (core 1 entry) */
+void exec_run(void);
+
+typedef struct {
+    const char *name;
+    uint32_t    runs;
+    uint32_t    overruns;
+    uint32_t    wcet_us;
+} exec_task_stats_t;
+
+typedef struct {
+    uint8_t           task_count;
+    uint8_t           load_pct;     /* 100 - idle share since the last call */
+    exec_task_stats_t task[EXEC_MAX_TASKS];
+} exec_stats_t;
+
+/* Snapshot for the UI (any core) */
+void exec_get_stats(exec_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EXEC_H */
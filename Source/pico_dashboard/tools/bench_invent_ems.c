@@ -0,0 +1,177 @@
+/**
+ * bench_invent_ems.c — host microbenchmark for the Invent EMS parser
+ *
+ * Builds a synthetic UART capture (valid TInfoPackets, rotating slow
+ * packet IDs) and replays it through the firmware parser:
+ *
+ *   clean  — back-to-back valid frames
+ *   noisy  — random garbage bursts, false sync prefixes and bit-flipped
+ *            frames between the valid ones, forcing resync
+ *
+ * Each stream is fed per byte (invent_ems_feed_byte) and in blocks of
+ * several sizes (invent_ems_feed_bytes); throughput is reported as MB/s
+ * and packets/s.  All modes must agree on the packet/error counts.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "invent_ems.h"
+
+#define PACKETS         200000
+#define INFO_LEN        37
+#define FRAME_LEN       (5 + 1 + INFO_LEN)
+#define REPEAT_MIN_NS   500000000ull    /* run each case for >= 0.5 s */
+
+/* ---- Stream generation ---- */
+
+/* Reference CRC: the shift/xor form used by the EMS firmware */
+static uint16_t ref_crc(const uint8_t *buf, size_t n)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t d = buf[i];
+        d ^= (uint8_t)(crc & 0xFF);
+        d ^= (uint8_t)(d << 4);
+        uint16_t t = ((uint16_t)d << 8) | ((crc >> 8) & 0xFF);
+        t ^= (uint8_t)(d >> 4);
+        t ^= (uint16_t)d << 3;
+        crc = t;
+    }
+    return crc;
+}
+
+static size_t put_frame(uint8_t *out, uint32_t seq)
+{
+    uint8_t *p = out;
+    *p++ = 0x55; *p++ = 0x00; *p++ = 0xAA; *p++ = 0x00; *p++ = 0x54;
+
+    uint8_t *pkt = p;
+    pkt[0] = INFO_LEN;
+    for (int i = 1; i < INFO_LEN - 1; i++)
+        pkt[i] = (uint8_t)(seq * 31 + i * 7);
+    pkt[24] = (uint8_t)(seq % 10);          /* slow packet id */
+
+    uint16_t crc = ref_crc(pkt, INFO_LEN - 1);
+    pkt[INFO_LEN - 1] = (uint8_t)crc;
+    pkt[INFO_LEN]     = (uint8_t)(crc >> 8);
+    return FRAME_LEN;
+}
+
+static uint8_t *make_stream(bool noisy, size_t *out_len)
+{
+    size_t cap = (size_t)PACKETS * FRAME_LEN * (noisy ? 2 : 1) + 64;
+    uint8_t *buf = malloc(cap);
+    size_t n = 0;
+    srand(12345);
+
+    for (uint32_t seq = 0; seq < PACKETS; seq++) {
+        if (noisy && (rand() % 4) == 0) {
+            /* Garbage burst, sometimes containing a false sync prefix */
+            int burst = 1 + rand() % 24;
+            for (int i = 0; i < burst && n < cap - FRAME_LEN * 2; i++)
+                buf[n++] = (uint8_t)rand();
+            if (rand() % 2) {
+                static const uint8_t fake[] = { 0x55, 0x00, 0xAA };
+                memcpy(&buf[n], fake, sizeof(fake));
+                n += sizeof(fake);
+            }
+        }
+        size_t at = n;
+        n += put_frame(&buf[n], seq);
+        if (noisy && (rand() % 16) == 0)
+            buf[at + 5 + 1 + rand() % (INFO_LEN - 1)] ^= 0x10;  /* bit flip */
+    }
+    *out_len = n;
+    return buf;
+}
+
+/* ---- Timing ---- */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* chunk == 0 → per-byte API */
+static void feed(const uint8_t *buf, size_t len, size_t chunk)
+{
+    if (chunk == 0) {
+        for (size_t i = 0; i < len; i++)
+            invent_ems_feed_byte(buf[i]);
+        return;
+    }
+    for (size_t i = 0; i < len; i += chunk)
+        invent_ems_feed_bytes(&buf[i], (len - i < chunk) ? len - i : chunk);
+}
+
+static int run_case(const char *name, const uint8_t *buf, size_t len,
+                    size_t chunk, uint32_t *pkts, uint32_t *errs)
+{
+    uint64_t elapsed = 0;
+    uint32_t rounds = 0;
+
+    do {
+        invent_ems_init();
+        uint64_t t0 = now_ns();
+        feed(buf, len, chunk);
+        elapsed += now_ns() - t0;
+        rounds++;
+    } while (elapsed < REPEAT_MIN_NS);
+
+    invent_ems_publish(0);
+    invent_ems_acquire();
+    const invent_ems_data_t *d = invent_ems_get_data();
+    double secs = (double)elapsed / 1e9 / rounds;
+
+    char mode[32];
+    if (chunk == 0) snprintf(mode, sizeof(mode), "feed_byte");
+    else            snprintf(mode, sizeof(mode), "feed_bytes/%zu", chunk);
+
+    printf("%-6s %-16s %9.2f MB/s %11.0f pkt/s   pkts=%lu errs=%lu\n",
+           name, mode, (double)len / secs / 1e6,
+           (double)d->packet_count / secs,
+           (unsigned long)d->packet_count, (unsigned long)d->error_count);
+
+    if (*pkts == UINT32_MAX) {
+        *pkts = d->packet_count;
+        *errs = d->error_count;
+        return 0;
+    }
+    if (d->packet_count != *pkts || d->error_count != *errs) {
+        fprintf(stderr, "  MISMATCH: expected pkts=%lu errs=%lu\n",
+                (unsigned long)*pkts, (unsigned long)*errs);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    static const size_t chunks[] = { 0, 1, 16, 64, 256, 4096 };
+    int failed = 0;
+
+    for (int noisy = 0; noisy <= 1; noisy++) {
+        size_t len;
+        uint8_t *buf = make_stream(noisy, &len);
+        uint32_t pkts = UINT32_MAX, errs = 0;
+
+        for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+            failed |= run_case(noisy ? "noisy" : "clean", buf, len,
+                               chunks[c], &pkts, &errs);
+
+        if (!noisy && pkts != PACKETS) {
+            fprintf(stderr, "clean stream: parsed %lu of %d packets\n",
+                    (unsigned long)pkts, PACKETS);
+            failed = 1;
+        }
+        free(buf);
+        printf("\n");
+    }
+    return failed;
+}
@@ -0,0 +1,192 @@
+/**
+ * bench_spsc_ring.cpp — host stress test and benchmark for spsc_ring.h
+ *
+ * Runs a producer and a consumer thread against one ring:
+ *
+ *   stress  — random burst sizes on both sides, mixing single push/pop,
+ *             bulk copies and in-place spans; every element carries a
+ *             sequence number and a checksum, so a lost, duplicated,
+ *             reordered or torn element fails the run
+ *   bench   — throughput for byte and CAN-frame sized elements, one at
+ *             a time and in bulk
+ *
+ * A side that makes no progress yields, so the test also completes on
+ * a single-CPU host (where the throughput numbers are meaningless).
+ *
+ * Exit status is non-zero if the stress test finds an error.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+#include "spsc_ring.h"
+
+#define STRESS_ELEMS    4000000u
+#define BENCH_BYTES     (64u * 1024 * 1024)
+
+/* Same size and shape as bsp_can_frame_t */
+struct frame_t {
+    uint32_t id;
+    uint8_t  data[8];
+    uint8_t  dlc;
+};
+
+static inline uint32_t check_of(uint32_t seq) { return seq * 0x9E3779B1u ^ 0xA5A5A5A5u; }
+
+static frame_t make_frame(uint32_t seq)
+{
+    frame_t f{};
+    f.id = seq;
+    uint32_t c = check_of(seq);
+    for (int i = 0; i < 8; i++) f.data[i] = (uint8_t)(c >> (i % 4 * 8));
+    f.dlc = 8;
+    return f;
+}
+
+static bool frame_ok(const frame_t &f, uint32_t seq)
+{
+    return f.id == seq && f.dlc == 8 &&
+           f.data[0] == (uint8_t)check_of(seq) &&
+           f.data[7] == (uint8_t)(check_of(seq) >> 24);
+}
+
+/* ---- Stress ---- */
+
+static int stress(void)
+{
+    static spsc_ring<frame_t, 64> ring;
+    std::atomic<uint32_t> errors{0};
+
+    std::thread producer([&] {
+        std::mt19937 rng(1);
+        uint32_t seq = 0;
+        frame_t  batch[48];
+        while (seq < STRESS_ELEMS) {
+            uint32_t before = seq;
+            switch (rng() % 3) {
+            case 0:                                     /* single */
+                if (ring.push(make_frame(seq))) seq++;
+                break;
+            case 1: {                                   /* bulk copy */
+                uint32_t n = 1 + rng() % 48;
+                if (n > STRESS_ELEMS - seq) n = STRESS_ELEMS - seq;
+                for (uint32_t i = 0; i < n; i++) batch[i] = make_frame(seq + i);
+                seq += ring.push(batch, n);
+                break;
+            }
+            default: {                                  /* in place */
+                frame_t *span;
+                uint32_t n = ring.write_span(&span);
+                uint32_t want = rng() % 48;
+                if (n > want) n = want;
+                if (n > STRESS_ELEMS - seq) n = STRESS_ELEMS - seq;
+                for (uint32_t i = 0; i < n; i++) span[i] = make_frame(seq + i);
+                ring.produce(n);
+                seq += n;
+                break;
+            }
+            }
+            if (seq == before) std::this_thread::yield();
+        }
+    });
+
+    std::thread consumer([&] {
+        std::mt19937 rng(2);
+        uint32_t seq = 0;
+        frame_t  batch[48];
+        while (seq < STRESS_ELEMS) {
+            uint32_t before = seq;
+            switch (rng() % 3) {
+            case 0: {
+                frame_t f;
+                if (ring.pop(f)) {
+                    if (!frame_ok(f, seq)) errors++;
+                    seq++;
+                }
+                break;
+            }
+            case 1: {
+                uint32_t n = ring.pop(batch, 1 + rng() % 48);
+                for (uint32_t i = 0; i < n; i++)
+                    if (!frame_ok(batch[i], seq + i)) errors++;
+                seq += n;
+                break;
+            }
+            default: {
+                const frame_t *span;
+                uint32_t n = ring.read_span(&span);
+                for (uint32_t i = 0; i < n; i++)
+                    if (!frame_ok(span[i], seq + i)) errors++;
+                ring.consume(n);
+                seq += n;
+                break;
+            }
+            }
+            if (seq == before) std::this_thread::yield();
+        }
+    });
+
+    producer.join();
+    consumer.join();
+
+    printf("stress  %u frames  errors=%u  high_water=%u/64  overflow=%u\n",
+           STRESS_ELEMS, errors.load(), ring.high_water(), ring.overflow());
+    return errors.load() != 0 || !ring.empty();
+}
+
+/* ---- Throughput ---- */
+
+template <typename T, uint32_t N>
+static void bench(const char *name, uint32_t chunk)
+{
+    static spsc_ring<T, N> ring;
+    const uint32_t count = BENCH_BYTES / sizeof(T);
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::thread producer([&] {
+        T buf[256] = {};
+        for (uint32_t sent = 0; sent < count; ) {
+            uint32_t n = count - sent < chunk ? count - sent : chunk;
+            uint32_t put = (chunk == 1) ? (uint32_t)ring.push(buf[0])
+                                        : ring.push(buf, n);
+            if (put == 0) std::this_thread::yield();
+            sent += put;
+        }
+    });
+    std::thread consumer([&] {
+        T buf[256];
+        for (uint32_t got = 0; got < count; ) {
+            uint32_t n = (chunk == 1) ? (uint32_t)ring.pop(buf[0])
+                                      : ring.pop(buf, chunk);
+            if (n == 0) std::this_thread::yield();
+            got += n;
+        }
+    });
+    producer.join();
+    consumer.join();
+
+    double secs = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - t0).count();
+    printf("bench   %-8s chunk %-4u %9.1f MB/s %8.1f M elem/s\n",
+           name, chunk, BENCH_BYTES / secs / 1e6, count / secs / 1e6);
+}
+
+int main(void)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    int failed = stress();
+    printf("\n");
+
+    bench<uint8_t, 1024>("byte", 1);
+    bench<uint8_t, 1024>("byte", 64);
+    bench<uint8_t, 1024>("byte", 256);
+    bench<frame_t, 32>("frame", 1);
+    bench<frame_t, 32>("frame", 8);
+    bench<frame_t, 32>("frame", 32);
+    return failed;
+}
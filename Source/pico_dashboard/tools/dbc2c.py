@@ -0,0 +1,267 @@
+#!/usr/bin/env python3
+"""
+dbc2c.py — compile a DBC file into const CAN decode tables (can_dbc.h)
+
+Usage:
+    dbc2c.py --dbc ME1_4.dbc --map me442_signals.map \
+             --name can_dbc_me442 --out-dir build/generated
+
+    dbc2c.py --dbc ME1_4.dbc --map me442_signals.map --bin me442.cdb
+
+The first form emits C sources that are linked into the firmware; the
+second writes a binary table (.cdb) that the dashboard loads from the SD
+card at boot (see can_dbc_load() for the layout).
+
+The map file binds DBC signal names to channels (INVENT_EMS_CHANNELS()
+in invent_ems.h):
+
+    # signal            field               [factor]
+    Oil_T               oil_temp
+    Oil_P               oil_pressure        0.01    # kPa -> bar
+
+`factor` is an extra unit conversion multiplied into both scale and
+offset.  Every signal in the DBC must be mapped (or listed with the
+field name `-` to drop it explicitly), so a DBC update that adds a
+signal fails the build instead of being silently ignored.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+import zlib
+
+BO_RE = re.compile(r'^BO_\s+(\d+)\s+(\w+)\s*:\s*(\d+)\s+\S+')
+SG_RE = re.compile(
+    r'^SG_\s+(\w+)\s*(?:\w+\s*)?:\s*(\d+)\|(\d+)@([01])([+-])\s*'
+    r'\(\s*([-+0-9.eE]+)\s*,\s*([-+0-9.eE]+)\s*\)')
+
+CAN_EFF_FLAG = 0x80000000
+MAX_SIGNAL_BITS = 16        # CAN_DBC_MAX_SIGNAL_BITS
+
+
+class Signal:
+    def __init__(self, name, start, length, little_endian, signed,
+                 scale, offset):
+        self.name = name
+        self.start = start
+        self.length = length
+        self.little_endian = little_endian
+        self.signed = signed
+        self.scale = scale
+        self.offset = offset
+        self.field = None
+        self.factor = 1.0
+
+    def shift(self):
+        """LSB position inside the 64-bit payload word (see can_dbc.h)."""
+        if self.little_endian:
+            return self.start
+        # Motorola: start bit is the MSB in sawtooth numbering.
+        msb = (7 - self.start // 8) * 8 + (self.start % 8)
+        return msb - self.length + 1
+
+    def min_dlc(self):
+        """Number of payload bytes needed to hold the signal."""
+        if self.little_endian:
+            return (self.start + self.length - 1) // 8 + 1
+        return 8 - self.shift() // 8
+
+
+class Message:
+    def __init__(self, can_id, name, dlc):
+        self.id = can_id
+        self.name = name
+        self.dlc = dlc
+        self.signals = []
+
+
+def parse_dbc(path):
+    messages = []
+    current = None
+    with open(path, encoding='latin-1') as f:
+        for line in f:
+            line = line.strip()
+            m = BO_RE.match(line)
+            if m:
+                raw_id = int(m.group(1))
+                can_id = raw_id & ~CAN_EFF_FLAG
+                current = Message(can_id, m.group(2), int(m.group(3)))
+                messages.append(current)
+                continue
+            m = SG_RE.match(line)
+            if m and current is not None:
+                current.signals.append(Signal(
+                    name=m.group(1),
+                    start=int(m.group(2)),
+                    length=int(m.group(3)),
+                    little_endian=(m.group(4) == '1'),
+                    signed=(m.group(5) == '-'),
+                    scale=float(m.group(6)),
+                    offset=float(m.group(7))))
+            elif not line:
+                current = None              # blank line ends a BO_ block
+    return messages
+
+
+def parse_map(path):
+    mapping = {}
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.split('#', 1)[0].strip()
+            if not line:
+                continue
+            parts = line.split()
+            if len(parts) not in (2, 3):
+                sys.exit('%s:%d: expected "signal field [factor]"'
+                         % (path, lineno))
+            factor = float(parts[2]) if len(parts) == 3 else 1.0
+            mapping[parts[0]] = (parts[1], factor)
+    return mapping
+
+
+def c_float(v):
+    s = repr(float(v))
+    if 'e' not in s and '.' not in s:
+        s += '.0'
+    return s + 'f'
+
+
+def channel_name(field):
+    """adc_an[3] -> adc_an3, as in INVENT_EMS_CHANNELS()."""
+    return re.sub(r'\[(\d+)\]', r'\1', field)
+
+
+def emit(messages, name, dbc_path, out_dir):
+    messages = sorted(messages, key=lambda m: m.id)
+    header = os.path.join(out_dir, name + '.h')
+    source = os.path.join(out_dir, name + '.c')
+    guard = name.upper() + '_H'
+    origin = os.path.basename(dbc_path)
+
+    with open(header, 'w') as h:
+        h.write('/* Generated by tools/dbc2c.py from %s — do not edit. */\n'
+                % origin)
+        h.write('#ifndef %s\n#define %s\n\n' % (guard, guard))
+        h.write('#include "can_dbc.h"\n\n')
+        h.write('extern const can_dbc_t %s;\n\n' % name)
+        h.write('#endif /* %s */\n' % guard)
+
+    with open(source, 'w') as c:
+        c.write('/* Generated by tools/dbc2c.py from %s — do not edit. */\n'
+                % origin)
+        c.write('#include "%s.h"\n#include "invent_ems.h"\n\n' % name)
+
+        c.write('static const can_dbc_signal_t signals[] = {\n')
+        index = 0
+        for msg in messages:
+            msg.first = index
+            c.write('    /* 0x%03X %s */\n' % (msg.id, msg.name))
+            for s in msg.signals:
+                flags = []
+                if s.signed:
+                    flags.append('CAN_DBC_SIGNED')
+                if not s.little_endian:
+                    flags.append('CAN_DBC_BIG_ENDIAN')
+                c.write('    { %s, %s, INVENT_EMS_CH_%s, %d, %d, %s, %d },'
+                        '  /* %s */\n' % (
+                            c_float(s.scale * s.factor),
+                            c_float(s.offset * s.factor),
+                            channel_name(s.field), s.shift(), s.length,
+                            ' | '.join(flags) or '0', s.min_dlc(), s.name))
+                index += 1
+        c.write('};\n\n')
+
+        c.write('static const can_dbc_message_t messages[] = {\n')
+        for msg in messages:
+            c.write('    { 0x%03X, %d, %d },  /* %s */\n'
+                    % (msg.id, msg.first, len(msg.signals), msg.name))
+        c.write('};\n\n')
+
+        c.write('const can_dbc_t %s = {\n' % name)
+        c.write('    .messages      = messages,\n')
+        c.write('    .signals       = signals,\n')
+        c.write('    .message_count = %d,\n' % len(messages))
+        c.write('    .signal_count  = %d,\n' % index)
+        c.write('};\n')
+
+
+def emit_bin(messages, path):
+    messages = sorted(messages, key=lambda m: m.id)
+    strtab = bytearray()
+    names = {}
+    msg_blob = bytearray()
+    sig_blob = bytearray()
+    index = 0
+
+    for msg in messages:
+        msg_blob += struct.pack('<IHBx', msg.id, index, len(msg.signals))
+        for s in msg.signals:
+            # Stored by channel name, resolved by invent_ems_resolve_channel()
+            name = channel_name(s.field)
+            if name not in names:
+                names[name] = len(strtab)
+                strtab += name.encode('ascii') + b'\0'
+            flags = (1 if s.signed else 0) | (0 if s.little_endian else 2)
+            sig_blob += struct.pack('<ffHBBBBxx',
+                                    s.scale * s.factor, s.offset * s.factor,
+                                    names[name], s.shift(), s.length,
+                                    flags, s.min_dlc())
+            index += 1
+
+    body = bytes(msg_blob + sig_blob + strtab)
+    header = struct.pack('<4sHHHHI', b'CDB1', len(messages), index,
+                         len(strtab), 0, zlib.crc32(body) & 0xFFFFFFFF)
+    with open(path, 'wb') as f:
+        f.write(header + body)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument('--dbc', required=True)
+    ap.add_argument('--map', required=True)
+    ap.add_argument('--name', help='C symbol / file stem for --out-dir')
+    ap.add_argument('--out-dir', help='emit <name>.c/.h into this directory')
+    ap.add_argument('--bin', help='write a binary .cdb table to this path')
+    args = ap.parse_args()
+    if not args.bin and not (args.name and args.out_dir):
+        ap.error('need --name and --out-dir, or --bin')
+
+    messages = parse_dbc(args.dbc)
+    mapping = parse_map(args.map)
+
+    errors = []
+    for msg in messages:
+        kept = []
+        for s in msg.signals:
+            if s.name not in mapping:
+                errors.append('signal %s (0x%X %s) is not mapped'
+                              % (s.name, msg.id, msg.name))
+                continue
+            field, factor = mapping[s.name]
+            if field == '-':
+                continue
+            if s.shift() < 0 or s.shift() + s.length > 64:
+                errors.append('signal %s does not fit in 8 bytes' % s.name)
+                continue
+            if s.length > MAX_SIGNAL_BITS:
+                errors.append('signal %s is wider than %d bits'
+                              % (s.name, MAX_SIGNAL_BITS))
+                continue
+            s.field, s.factor = field, factor
+            kept.append(s)
+        msg.signals = kept
+    if errors:
+        sys.exit('\n'.join('%s: %s' % (args.dbc, e) for e in errors))
+
+    messages = [m for m in messages if m.signals]
+    if args.out_dir:
+        os.makedirs(args.out_dir, exist_ok=True)
+        emit(messages, args.name, args.dbc, args.out_dir)
+    if args.bin:
+        emit_bin(messages, args.bin)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+"""
+dlog_decode.py — turn the dashboard's binary log (dlog.h) back into text
+
+Usage:
+    dlog_decode.py build/pico_dashboard.elf dlog.bin      # from the SD card
+    dlog_decode.py build/pico_dashboard.elf /dev/ttyACM0  # live, DLOG_USB build
+    dlog_decode.py build/pico_dashboard.elf - < dlog.bin
+
+The ELF must be the one that produced the log: records carry offsets
+into its `dlog_fmt` section, not text.  %s arguments are read from the
+ELF too (string literals in flash).
+
+Output, one line per record, sorted by time within each drain:
+
+    [   12.345678] c1 W can: rx ring full, id 0x201 dropped
+
+Each drain starts with a sync record; the decoder starts at the first
+one it finds, so it can attach to a stream at any point.  A timestamp
+that runs backwards (other than the 71 minute wrap) is a reboot.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+SYNC = 0xFFFFFFFF
+MAX_ARGS = 6
+LEVELS = 'EWID'
+
+SHT_NOBITS = 8
+SHF_ALLOC = 0x2
+
+SPEC_RE = re.compile(
+    r'%([-+ #0]*)(\d+)?(?:\.(\d+))?(?:hh|h|ll|l|z|j|t)?([diuxXocsp%])')
+
+
+class Elf:
+    """The few bits of a little-endian ELF image the decoder needs (the
+    firmware is ELF32; ELF64 is accepted for host builds)"""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        d = self.data
+        if d[:4] != b'\x7fELF' or d[4] not in (1, 2) or d[5] != 1:
+            sys.exit('%s: not a little-endian ELF' % path)
+
+        if d[4] == 1:
+            shoff, = struct.unpack_from('<I', d, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', d, 0x2E)
+            sh = '<IIIIII'
+        else:
+            shoff, = struct.unpack_from('<Q', d, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from('<HHH', d, 0x3A)
+            sh = '<IIQQQQ'
+
+        # name, type, flags, addr, offset, size
+        raw = [struct.unpack_from(sh, d, shoff + i * shentsize)
+               for i in range(shnum)]
+        names_off = raw[shstrndx][4]
+
+        # (addr, file offset, size) of every loaded section, for %s
+        self.sections = []
+        self.fmt = None
+        for name, typ, flags, addr, off, size in raw:
+            end = d.index(b'\0', names_off + name)
+            sname = d[names_off + name:end].decode()
+            if sname == 'dlog_fmt':
+                self.fmt = (off, size)
+            if flags & SHF_ALLOC and typ != SHT_NOBITS and size:
+                self.sections.append((addr, off, size))
+        if self.fmt is None:
+            sys.exit('%s: no dlog_fmt section (built without dlog?)' % path)
+
+    def _cstr(self, off, limit):
+        end = self.data.find(b'\0', off, limit)
+        if end < 0:
+            return None
+        return self.data[off:end].decode('utf-8', 'replace')
+
+    def format_string(self, offset):
+        off, size = self.fmt
+        if offset >= size:
+            return None
+        return self._cstr(off + offset, off + size)
+
+    def string_at(self, addr):
+        for base, off, size in self.sections:
+            if base <= addr < base + size:
+                return self._cstr(off + addr - base, off + size)
+        return None
+
+
+def render(elf, fmt, args):
+    """printf for 32-bit words"""
+    args = list(args)
+
+    def one(m):
+        flags, width, prec, conv = m.groups()
+        if conv == '%':
+            return '%'
+        if not args:
+            return '<missing>'
+        v = args.pop(0)
+        spec = '%' + flags + (width or '') + ('.' + prec if prec else '')
+        if conv in 'di':
+            return (spec + 'd') % (v - (1 << 32) if v & 0x80000000 else v)
+        if conv == 'u':
+            return (spec + 'd') % v
+        if conv in 'xXo':
+            return (spec + conv) % v
+        if conv == 'c':
+            return (spec + 'c') % chr(v & 0xFF)
+        if conv == 'p':
+            return (spec + 's') % ('0x%08x' % v)
+        s = elf.string_at(v)                                    # %s
+        return (spec + 's') % (s if s is not None else '<0x%08x>' % v)
+
+    return SPEC_RE.sub(one, fmt)
+
+
+class Decoder:
+    def __init__(self, elf, out):
+        self.elf = elf
+        self.out = out
+        self.buf = b''
+        self.synced = False
+        self.batch = []
+        self.dropped = [0, 0]
+        self._reset_time()
+
+    def _reset_time(self):
+        self.epoch = [0, 0]     # µs added for wraps, per core
+        self.last = [None, None]
+
+    def _time(self, core, t):
+        """Each core's records are in time order; the sync record's time
+        (when the drain ran) is not used"""
+        last = self.last[core]
+        if last is not None and t < last:
+            if last - t > 1 << 31:
+                self.epoch[core] += 1 << 32         # time_us_32 wrapped
+            else:
+                self._flush()
+                self.out.write('--- restart ---\n')
+                self._reset_time()
+                self.dropped = [0, 0]
+        self.last[core] = t
+        return self.epoch[core] + t
+
+    def _flush(self):
+        for t, core, level, text in sorted(self.batch, key=lambda r: r[0]):
+            self.out.write('[%6d.%06d] c%d %s %s\n' % (
+                t // 1000000, t % 1000000, core, LEVELS[level], text))
+        self.batch = []
+
+    def _header_ok(self, hdr):
+        return hdr == SYNC or (
+            (hdr & 0xF) <= MAX_ARGS and (hdr & 0x40) == 0 and
+            self.elf.format_string(hdr >> 8) is not None)
+
+    def _resync(self):
+        """Skip to the next sync record; False if more data is needed"""
+        while True:
+            i = self.buf.find(b'\xff\xff\xff\xff')
+            if i < 0:
+                self.buf = self.buf[-3:]
+                return False
+            if len(self.buf) < i + 20:
+                self.buf = self.buf[i:]
+                return False
+            nxt, = struct.unpack_from('<I', self.buf, i + 16)
+            if self._header_ok(nxt):
+                self.buf = self.buf[i:]
+                self.synced = True
+                return True
+            self.buf = self.buf[i + 1:]
+
+    def feed(self, data):
+        self.buf += data
+        pos = 0
+        while True:
+            if not self.synced:
+                self.buf = self.buf[pos:]
+                pos = 0
+                if not self._resync():
+                    return
+            if len(self.buf) - pos < 8:
+                break
+            hdr, t = struct.unpack_from('<II', self.buf, pos)
+
+            if hdr == SYNC:
+                if len(self.buf) - pos < 16:
+                    break
+                d0, d1 = struct.unpack_from('<II', self.buf, pos + 8)
+                pos += 16
+                self._flush()
+                for core, d in enumerate((d0, d1)):
+                    if d > self.dropped[core]:
+                        self.out.write('--- core %d: %d records dropped ---\n'
+                                       % (core, d - self.dropped[core]))
+                    self.dropped[core] = d
+                continue
+
+            if not self._header_ok(hdr):
+                self.out.write('--- lost sync ---\n')
+                self.synced = False
+                pos += 1
+                continue
+
+            n = hdr & 0xF
+            if len(self.buf) - pos < 8 + 4 * n:
+                break
+            args = struct.unpack_from('<%dI' % n, self.buf, pos + 8)
+            pos += 8 + 4 * n
+
+            fmt = self.elf.format_string(hdr >> 8)
+            core = (hdr >> 7) & 1
+            self.batch.append((self._time(core, t), core, (hdr >> 4) & 3,
+                               render(self.elf, fmt, args)))
+        self.buf = self.buf[pos:]
+
+    def finish(self):
+        self._flush()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument('elf', help='firmware ELF that produced the log')
+    ap.add_argument('input', help='log file, serial device, or - for stdin')
+    args = ap.parse_args()
+
+    elf = Elf(args.elf)
+    dec = Decoder(elf, sys.stdout)
+
+    if args.input == '-':
+        fd = sys.stdin.fileno()
+    else:
+        fd = os.open(args.input, os.O_RDONLY)
+    if os.isatty(fd):
+        import tty
+        tty.setraw(fd)          # no line discipline on the binary stream
+
+    try:
+        while True:
+            data = os.read(fd, 4096)
+            if not data:
+                break
+            dec.feed(data)
+            if os.isatty(fd):
+                dec.finish()    # live: print each drain as it arrives
+                sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    dec.finish()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""
+prof_report.py — flat profile and collapsed stacks from a profiler dump
+
+Usage:
+    prof_report.py build/pico_dashboard.elf prof00.bin
+    prof_report.py build/pico_dashboard.elf prof00.bin --collapsed prof.folded
+    flamegraph.pl prof.folded > prof.svg      # or load it in speedscope
+
+The ELF must be the one that was running (diag/profiler.h).  Per core
+it prints the functions by share of samples, where the samples ran
+(flash through the XIP cache, SRAM, boot ROM), the flash cache hit rate
+and, with --addrs, the hottest instructions.
+
+Stacks are two levels deep at most: a sample's LR is taken as its call
+site only when the instruction before it is a BL/BLX in a different
+function; otherwise (a non-leaf function with a stale LR, or an
+exception return) the sample is a one-level stack.
+"""
+
+import argparse
+import bisect
+import shutil
+import struct
+import subprocess
+import sys
+
+MAGIC = 0x31465250
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHF_ALLOC = 0x2
+STT_FUNC = 2
+
+REGIONS = (                 # RP2350 address map
+    (0x00000000, 0x00008000, 'boot ROM'),
+    (0x10000000, 0x14000000, 'flash (XIP)'),
+    (0x20000000, 0x20082000, 'SRAM'),
+)
+
+
+class Elf:
+    """Function symbols and loaded bytes of a little-endian ELF32"""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            d = self.data = f.read()
+        if d[:4] != b'\x7fELF' or d[4] != 1 or d[5] != 1:
+            sys.exit('%s: not a little-endian ELF32' % path)
+
+        shoff, = struct.unpack_from('<I', d, 0x20)
+        shentsize, shnum, _ = struct.unpack_from('<HHH', d, 0x2E)
+        # name, type, flags, addr, offset, size, link
+        raw = [struct.unpack_from('<IIIIIII', d, shoff + i * shentsize)
+               for i in range(shnum)]
+
+        self.sections = [(addr, off, size)
+                         for _, typ, flags, addr, off, size, _ in raw
+                         if flags & SHF_ALLOC and typ != SHT_NOBITS and size]
+
+        funcs = {}
+        for _, typ, _, _, off, size, link in raw:
+            if typ != SHT_SYMTAB:
+                continue
+            stroff = raw[link][4]
+            for i in range(0, size, 16):
+                name, value, fsize, info = struct.unpack_from(
+                    '<IIIB', d, off + i)
+                if info & 0xF != STT_FUNC or fsize == 0:
+                    continue
+                end = d.index(b'\0', stroff + name)
+                funcs[value & ~1] = (fsize, d[stroff + name:end].decode())
+        if not funcs:
+            sys.exit('%s: no function symbols (stripped?)' % path)
+
+        self.addrs = sorted(funcs)
+        self.funcs = [funcs[a] for a in self.addrs]
+        self.names = demangle([n for _, n in self.funcs])
+
+    def function(self, addr):
+        """(start, name) of the function holding addr, or None"""
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        if i >= 0 and addr < self.addrs[i] + self.funcs[i][0]:
+            return self.addrs[i], self.names[i]
+        return None
+
+    def halfword(self, addr):
+        for base, off, size in self.sections:
+            if base <= addr and addr + 2 <= base + size:
+                return struct.unpack_from('<H', self.data, off + addr - base)[0]
+        return None
+
+
+def demangle(names):
+    """C++ names through c++filt when there is one"""
+    tool = shutil.which('arm-none-eabi-c++filt') or shutil.which('c++filt')
+    if not tool:
+        return names
+    out = subprocess.run([tool], input='\n'.join(names), text=True,
+                         capture_output=True).stdout.splitlines()
+    return out if len(out) == len(names) else names
+
+
+def region(addr):
+    for lo, hi, name in REGIONS:
+        if lo <= addr < hi:
+            return name
+    return 'other'
+
+
+def symbolize(elf, addr):
+    f = elf.function(addr & ~1)
+    if f is None:
+        return '[%s 0x%08x]' % (region(addr), addr)
+    return f[1]
+
+
+def call_site(elf, lr):
+    """The function that made the call returning to lr, or None"""
+    if lr & 0xFF000000 == 0xFF000000 or not lr & 1:
+        return None                         # EXC_RETURN, or not Thumb code
+    ret = lr & ~1
+    hw1, hw2 = elf.halfword(ret - 4), elf.halfword(ret - 2)
+    bl = (hw1 is not None and hw2 is not None and
+          hw1 & 0xF800 == 0xF000 and hw2 & 0xC000 == 0xC000)
+    blx = hw2 is not None and hw2 & 0xFF87 == 0x4780
+    if not (bl or blx):
+        return None
+    f = elf.function(ret - 2)
+    return f[1] if f else None
+
+
+def read_dump(path):
+    with open(path, 'rb') as f:
+        d = f.read()
+    magic, period, xip_hit, xip_acc = struct.unpack_from('<IIII', d, 0)
+    if magic != MAGIC:
+        sys.exit('%s: not a profiler dump' % path)
+    pos, cores = 16, []
+    for _ in range(2):
+        samples, dropped, n = struct.unpack_from('<III', d, pos)
+        pos += 12
+        entries = [struct.unpack_from('<III', d, pos + 12 * i)
+                   for i in range(n)]
+        pos += 12 * n
+        cores.append((samples, dropped, entries))
+    return period, xip_hit, xip_acc, cores
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    ap.add_argument('elf', help='firmware ELF that was running')
+    ap.add_argument('dump', help='profiler dump (profNN.bin)')
+    ap.add_argument('--top', type=int, default=25,
+                    help='functions listed per core (default 25)')
+    ap.add_argument('--addrs', type=int, default=0, metavar='N',
+                    help='also list the N hottest instructions per core')
+    ap.add_argument('--collapsed', metavar='FILE',
+                    help='write collapsed stacks for flamegraph tools')
+    args = ap.parse_args()
+
+    elf = Elf(args.elf)
+    period, xip_hit, xip_acc, cores = read_dump(args.dump)
+
+    print('sample period %d us' % period)
+    if xip_acc:
+        sat = ' (saturated)' if 0xFFFFFFFF in (xip_hit, xip_acc) else ''
+        print('flash cache hit rate %.2f%% of %d accesses%s'
+              % (100.0 * xip_hit / xip_acc, xip_acc, sat))
+
+    folded = {}
+    for core, (samples, dropped, entries) in enumerate(cores):
+        print('\n=== core %d: %d samples (%.1f s)%s ===' % (
+            core, samples, samples * period / 1e6,
+            ', %d dropped (table full)' % dropped if dropped else ''))
+        if not samples:
+            continue
+
+        flat, where, addrs = {}, {}, {}
+        for pc, lr, count in entries:
+            fn = symbolize(elf, pc)
+            flat[fn] = flat.get(fn, 0) + count
+            where[region(pc)] = where.get(region(pc), 0) + count
+            addrs[pc] = addrs.get(pc, 0) + count
+
+            caller = call_site(elf, lr)
+            stack = ('core%d;%s;%s' % (core, caller, fn)
+                     if caller and caller != fn else 'core%d;%s' % (core, fn))
+            folded[stack] = folded.get(stack, 0) + count
+
+        print('  '.join('%s %.1f%%' % (r, 100.0 * n / samples)
+                        for r, n in sorted(where.items(), key=lambda x: -x[1])))
+        print('%8s %6s %6s  %s' % ('samples', 'self', 'cum', 'function'))
+        cum = 0
+        for fn, n in sorted(flat.items(), key=lambda x: -x[1])[:args.top]:
+            cum += n
+            print('%8d %5.1f%% %5.1f%%  %s' % (
+                n, 100.0 * n / samples, 100.0 * cum / samples, fn))
+
+        if args.addrs:
+            print('%8s %6s  %s' % ('samples', 'self', 'address'))
+            for pc, n in sorted(addrs.items(),
+                                key=lambda x: -x[1])[:args.addrs]:
+                f = elf.function(pc & ~1)
+                where_s = '%s+0x%x' % (f[1], (pc & ~1) - f[0]) if f else ''
+                print('%8d %5.1f%%  0x%08x %s' % (
+                    n, 100.0 * n / samples, pc, where_s))
+
+    if args.collapsed:
+        with open(args.collapsed, 'w') as f:
+            for stack, n in sorted(folded.items()):
+                f.write('%s %d\n' % (stack, n))
+
+
+if __name__ == '__main__':
+    main()
@@ -2,8 +2,10 @@
  * ui_debug_console.c — tap-to-show bus statistics overlay
  *
  * A full-screen semi-transparent panel (80 % opacity) sits on top of
- * the dashboard.  Tap the dashboard to open, tap the panel to close.
- * When hidden, update_stats() returns immediately — no rendering cost.
+ * the dashboard.  Tap the dashboard to open the bus page; tap the panel
+ * to step to the performance and memory page, and again to close.  Only the
+ * page on screen is formatted; when hidden, both update calls return
+ * immediately — no rendering cost.
  *
  * Compiled only when ENABLE_DEBUG_CONSOLE=1 (see ui_debug_console.h).
  */
@@ -21,7 +23,14 @@
 /* ---- State ---- */
 static lv_obj_t *console_panel;
 static lv_obj_t *console_label;
-static bool      console_visible;
+
+typedef enum {
+    PAGE_HIDDEN,
+    PAGE_BUS,
+    PAGE_PERF,
+} console_page_t;
+
+static console_page_t console_page;
 
 /* Previous counters for rate calculation (delta × 5 = per-second) */
 static uint32_t prev_uart_pkts;
@@ -32,18 +41,22 @@ static uint32_t prev_can_rx;
 static void dashboard_click_cb(lv_event_t *e)
 {
     (void)e;
-    if (!console_visible) {
+    if (console_page == PAGE_HIDDEN) {
         lv_obj_clear_flag(console_panel, LV_OBJ_FLAG_HIDDEN);
-        console_visible = true;
+        console_page = PAGE_BUS;
     }
 }
 
 static void panel_click_cb(lv_event_t *e)
 {
     (void)e;
-    if (console_visible) {
+    if (console_page == PAGE_BUS && ENABLE_RENDER_PERF) {
+        /* Shown until the next stats tick fills it in */
+        lv_label_set_text_static(console_label, "Render\nWaiting for data...");
+        console_page = PAGE_PERF;
+    } else if (console_page != PAGE_HIDDEN) {
         lv_obj_add_flag(console_panel, LV_OBJ_FLAG_HIDDEN);
-        console_visible = false;
+        console_page = PAGE_HIDDEN;
     }
 }
 
@@ -65,8 +78,8 @@ void ui_debug_console_init(void)
     lv_obj_set_style_bg_opa(console_panel, LV_OPA_80, 0);
     lv_obj_set_style_border_width(console_panel, 0, 0);
     lv_obj_set_style_radius(console_panel, PANEL_RADIUS, 0);
-    lv_obj_set_style_pad_top(console_panel, 90, 0);
-    lv_obj_set_style_pad_bottom(console_panel, 90, 0);
+    lv_obj_set_style_pad_top(console_panel, 70, 0);
+    lv_obj_set_style_pad_bottom(console_panel, 70, 0);
     lv_obj_set_style_pad_left(console_panel, 70, 0);
     lv_obj_set_style_pad_right(console_panel, 70, 0);
     lv_obj_clear_flag(console_panel, LV_OBJ_FLAG_SCROLLABLE);
@@ -84,14 +97,16 @@ void ui_debug_console_init(void)
 
     /* Start hidden — no rendering cost until the user taps */
     lv_obj_add_flag(console_panel, LV_OBJ_FLAG_HIDDEN);
-    console_visible = false;
+    console_page = PAGE_HIDDEN;
 }
 
 void ui_debug_console_update_stats(
     uint32_t uart_pkts, uint32_t uart_errs, bool uart_connected,
-    const bsp_can_stats_t *can)
+    const bsp_can_stats_t *can, const invent_ems_snapshot_stats_t *snap,
+    const latency_summary_t lat[LATENCY_STAGE_COUNT],
+    const exec_stats_t *exec)
 {
-    if (!console_visible) return;
+    if (console_page != PAGE_BUS) return;
 
     /* Rate: this callback fires every 200 ms → delta × 5 = per second */
     uint32_t uart_rate = (uart_pkts - prev_uart_pkts) * 5;
@@ -99,21 +114,37 @@ void ui_debug_console_update_stats(
     prev_uart_pkts = uart_pkts;
     prev_can_rx    = can->rx_total;
 
-    static char buf[384];
-    snprintf(buf, sizeof(buf),
+    char bus[12];                           /* "500k" or "auto" */
+    if (can->bitrate != 0)
+        snprintf(bus, sizeof(bus), "%luk", (unsigned long)(can->bitrate / 1000));
+    else
+        snprintf(bus, sizeof(bus), "auto");
+
+    uint32_t overwrites = 0;
+    for (uint8_t i = 0; i < can->mailbox_count; i++)
+        overwrites += can->mb_overwrite[i];
+
+    static char buf[640];
+    int n = snprintf(buf, sizeof(buf),
         "UART  %s\n"
         "  pkts:%lu rate:%lu err:%lu\n"
-        "\n"
-        "CAN   %s\n"
+        "CAN   %s  %s\n"
         "  rx:%lu tx:%lu att:%lu\n"
         "  rate:%lu err:%lu\n"
         "  irq:%lu clk:%luMHz\n"
-        "  RXpin:%u errSt:%lu",
+        "  RXpin:%u errSt:%lu\n"
+        "  %s drop:%lu flt:%lu ovw:%lu\n"
+        "SNAP  pub:%lu ui:%lu\n"
+        "  skip:%lu\n"
+        "LAT   bus>glass us (n:%lu)\n"
+        "  p50:%lu p99:%lu max:%lu\n"
+        "  p99 dec:%lu pub:%lu ui:%lu\n"
+        "      rnd:%lu dma:%lu",
         uart_connected ? "OK" : "--",
         (unsigned long)uart_pkts,
         (unsigned long)uart_rate,
         (unsigned long)uart_errs,
-        can->connected ? "OK" : "--",
+        can->connected ? "OK" : "--", bus,
         (unsigned long)can->rx_total,
         (unsigned long)can->tx_total,
         (unsigned long)can->tx_attempt,
@@ -122,7 +153,99 @@ void ui_debug_console_update_stats(
         (unsigned long)can->irq_count,
         (unsigned long)(can->sys_clk_hz / 1000000),
         (unsigned)can->rx_pin_raw,
-        (unsigned long)can->err_state);
+        (unsigned long)can->err_state,
+        can->mailbox_count ? "MB" : "FIFO",
+        (unsigned long)can->rx_dropped,
+        (unsigned long)can->rx_filtered,
+        (unsigned long)overwrites,
+        (unsigned long)snap->published,
+        (unsigned long)snap->consumed,
+        (unsigned long)(snap->published - snap->consumed),
+        (unsigned long)lat[LATENCY_TOTAL].count,
+        (unsigned long)lat[LATENCY_TOTAL].p50_us,
+        (unsigned long)lat[LATENCY_TOTAL].p99_us,
+        (unsigned long)lat[LATENCY_TOTAL].max_us,
+        (unsigned long)lat[LATENCY_DECODE].p99_us,
+        (unsigned long)lat[LATENCY_PUBLISH].p99_us,
+        (unsigned long)lat[LATENCY_UI].p99_us,
+        (unsigned long)lat[LATENCY_RENDER].p99_us,
+        (unsigned long)lat[LATENCY_GLASS].p99_us);
+
+    /* Core 1 executive: load, then worst-case runtime / overruns per task */
+    uint32_t overruns = 0;
+    for (uint8_t i = 0; i < exec->task_count; i++)
+        overruns += exec->task[i].overruns;
+    n += snprintf(buf + n, sizeof(buf) - n, "\nEXEC  load:%u%% ovr:%lu\n ",
+                  (unsigned)exec->load_pct, (unsigned long)overruns);
+    for (uint8_t i = 0; i < exec->task_count && n < (int)sizeof(buf); i++)
+        n += snprintf(buf + n, sizeof(buf) - n, " %s:%lu/%lu",
+                      exec->task[i].name,
+                      (unsigned long)exec->task[i].wcet_us,
+                      (unsigned long)exec->task[i].overruns);
+
+    lv_label_set_text_static(console_label, buf);
+}
+
+void ui_debug_console_update_perf(const render_perf_stats_t *perf,
+                                  const exec_stats_t *exec,
+                                  const mem_stats_t *mem)
+{
+    if (console_page != PAGE_PERF) return;
+
+    uint32_t vsync_hz_x10 = perf->vsync_period_us ?
+        10000000u / perf->vsync_period_us : 0;
+
+    static char buf[512];
+    snprintf(buf, sizeof(buf),
+        "RENDER  %lu.%lu fps\n"
+        "  frame avg:%luus\n"
+        "  render avg:%lu max:%luus\n"
+        "  flush avg:%luus dma:%u%%\n"
+        "  link:%lu.%luMB/s isr:%luus\n"
+        "  px/s:%lu\n"
+        "  px/frame:%lu sent:%lu\n"
+        "  lost:%lu\n"
+        "VSYNC %lu.%luHz miss:%lu\n"
+        "  headroom avg:%ld min:%ldus\n"
+        "CPU   core0:%u%% core1:%u%%\n"
+        "STACK c0:%lu/%lu c1:%lu/%lu\n"
+        "LVMEM %lu/%luk max:%luk\n"
+        "  frag:%u%% peak:%u%% big:%luk\n"
+        "HEAP  %lu/%luk used:%luk",
+        (unsigned long)(perf->fps_x10 / 10),
+        (unsigned long)(perf->fps_x10 % 10),
+        (unsigned long)perf->frame_avg_us,
+        (unsigned long)perf->render_avg_us,
+        (unsigned long)perf->render_max_us,
+        (unsigned long)perf->flush_avg_us,
+        (unsigned)perf->dma_pct,
+        (unsigned long)(perf->flush_mbps_x10 / 10),
+        (unsigned long)(perf->flush_mbps_x10 % 10),
+        (unsigned long)perf->flush_isr_max_us,
+        (unsigned long)perf->px_per_s,
+        (unsigned long)perf->area_px_avg,
+        (unsigned long)perf->sent_px_avg,
+        (unsigned long)perf->dropped,
+        (unsigned long)(vsync_hz_x10 / 10),
+        (unsigned long)(vsync_hz_x10 % 10),
+        (unsigned long)perf->vsync_missed,
+        (long)perf->headroom_avg_us,
+        (long)perf->headroom_min_us,
+        (unsigned)perf->core0_load_pct,
+        (unsigned)exec->load_pct,
+        (unsigned long)mem->stack[0].used,
+        (unsigned long)mem->stack[0].size,
+        (unsigned long)mem->stack[1].used,
+        (unsigned long)mem->stack[1].size,
+        (unsigned long)(mem->lv_used / 1024),
+        (unsigned long)(mem->lv_total / 1024),
+        (unsigned long)(mem->lv_max_used / 1024),
+        (unsigned)mem->lv_frag_pct,
+        (unsigned)mem->lv_frag_peak_pct,
+        (unsigned long)(mem->lv_biggest_free / 1024),
+        (unsigned long)(mem->heap_arena / 1024),
+        (unsigned long)(mem->heap_size / 1024),
+        (unsigned long)(mem->heap_used / 1024));
 
     lv_label_set_text_static(console_label, buf);
 }
@@ -9,6 +9,11 @@ extern "C" {
 #include <stdbool.h>
 #include "config.h"
 #include "bsp_can.h"
+#include "invent_ems.h"
+#include "latency_trace.h"
+#include "exec.h"
+#include "render_perf.h"
+#include "mem_watch.h"
 
 #if ENABLE_DEBUG_CONSOLE
 
@@ -16,16 +21,32 @@ void ui_debug_console_init(void);
 
 void ui_debug_console_update_stats(
     uint32_t uart_pkts, uint32_t uart_errs, bool uart_connected,
-    const bsp_can_stats_t *can);
+    const bsp_can_stats_t *can, const invent_ems_snapshot_stats_t *snap,
+    const latency_summary_t lat[LATENCY_STAGE_COUNT],
+    const exec_stats_t *exec);
+
+/* Second page: frame timing, CPU load per core, stacks and heaps */
+void ui_debug_console_update_perf(const render_perf_stats_t *perf,
+                                  const exec_stats_t *exec,
+                                  const mem_stats_t *mem);
 
 #else /* stubs — optimised away completely */
 
 static inline void ui_debug_console_init(void) {}
 static inline void ui_debug_console_update_stats(
     uint32_t uart_pkts, uint32_t uart_errs, bool uart_connected,
-    const bsp_can_stats_t *can)
+    const bsp_can_stats_t *can, const invent_ems_snapshot_stats_t *snap,
+    const latency_summary_t lat[LATENCY_STAGE_COUNT],
+    const exec_stats_t *exec)
 {
     (void)uart_pkts; (void)uart_errs; (void)uart_connected; (void)can;
+    (void)snap; (void)lat; (void)exec;
+}
+static inline void ui_debug_console_update_perf(
+    const render_perf_stats_t *perf, const exec_stats_t *exec,
+    const mem_stats_t *mem)
+{
+    (void)perf; (void)exec; (void)mem;
 }
 
 #endif /* ENABLE_DEBUG_CONSOLE */